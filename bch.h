@@ -0,0 +1,367 @@
+/*******************************************************************************
+*
+*    File Name:  bch.h
+*
+*  Description:  libbch, reentrant binary BCH encoder and decoder
+*
+*     Function:   1. bch_init() builds a code context:  the Galois field,
+*		     generator polynomial, remainder / lookahead tables and
+*		     vector kernel constants.  It is read only afterwards and
+*		     may be shared by any number of threads.
+*		  2. bch_work_new() allocates the scratch state of one caller;
+*		     each thread needs its own.
+*		  3. bch_encode() and bch_decode() work on caller buffers of
+*		     packed bits, MSB first:  the data stream d0 .. d(k-1), then
+*		     the parity b0 .. b(r-1).
+*
+*		  The command line tools are wrappers around this interface.
+*
+*******************************************************************************/
+
+#ifndef BCH_H
+#define BCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#define mm_max  20         	/* Dimension of Galoise Field */
+#define nn_max  1048576        	/* Length of codeword, n = 2**m - 1 */
+#define tt_max  100          	/* Number of errors that can be corrected */
+#define kk_max  1048576        	/* Length of information bit, kk = nn - rr  */
+#define rr_max  (mm_max * tt_max)	/* Number of parity checks, rr = deg[g(x)] <= m t */
+#define parallel_max  32	/* Number of parallel encoding/syndrome computations */
+#define rem_words_max  ((rr_max + 63) / 64)	/* 64-bit words in a packed remainder */
+#define slice_max  8		/* Bytes consumed per step of the table driven remainder */
+#define DEBUG  0
+
+/* Default values */
+#define df_m  13              	// BCH code over GF(2**mm)
+#define df_t  4              	// Number of errors that can be corrected
+#define df_p  8              	// Number of substreams to calculate in parallel
+
+/* bch_init() flags */
+#define BCH_LOOKAHEAD  0x01	// Bit-serial lookahead matrix encoder and syndromes
+#define BCH_DIRECT  0x02	// Syndromes straight from the received bytes
+#define BCH_INVERSIONLESS  0x04	// Inversionless Berlekamp-Massey
+#define BCH_VERBOSE  0x08	// Trace the code on stderr and each decode on stdout
+#define BCH_CACHE  0x10		// Map the code tables from the cache file, see bch_cache.c
+#define BCH_GENERIC  0x20	// Never bind a specialised codec, see bch_fixed.c
+#define BCH_STATS  0x40		// Count and time the decoder stages in bch_work.stats
+
+#define gf_lanes  32		/* Field elements per vector step */
+
+typedef struct {
+	unsigned char lo[gf_lanes] __attribute__((aligned(32)));
+	unsigned char hi[gf_lanes] __attribute__((aligned(32)));
+} gf_planes ;
+
+typedef struct {
+	unsigned char nib[8][16] __attribute__((aligned(16)));	// Low, high byte of (nibble n of x) * c at [2n], [2n+1]
+	uint64_t aff[4] ;		// GF2P8AFFINEQB matrices lo<-lo, lo<-hi, hi<-lo, hi<-hi
+} gf_const ;
+
+typedef struct {
+	const char *name ;
+	void (*mulc)(gf_planes *x, const gf_const *k) ;
+	// acc = acc * k + in[q], for q = n-1 down to 0
+	void (*horner)(gf_planes *acc, const gf_const *k, const gf_planes *in, int n) ;
+	// Mask of lanes where term[1] + ... + term[deg] == 1, then term[j] *= k[j]
+	uint32_t (*chien)(gf_planes *term, const gf_const *k, int deg) ;
+} gf_kernel ;
+
+static inline void gf_set_lane(gf_planes *x, int l, int v)
+{	x->lo[l] = v & 0xff ;
+	x->hi[l] = v >> 8 ;
+}
+
+static inline int gf_get_lane(const gf_planes *x, int l)
+{	return x->lo[l] | (x->hi[l] << 8) ;
+}
+
+typedef struct bch_fixed bch_fixed ;
+
+/* Decoder stages timed with BCH_STATS */
+#define stat_syndrome  0	// Syndromes
+#define stat_low_weight  1	// Closed form decode of one and two errors
+#define stat_key_equation  2	// Berlekamp-Massey
+#define stat_roots  3		// Closed form roots or Chien search
+#define stat_stages  4
+#define stat_sample  15		// Time one codeword in stat_sample + 1
+
+typedef struct {
+	uint64_t codewords ;			// Codewords decoded
+	uint64_t calls[stat_stages] ;		// Codewords reaching each stage
+	uint64_t timed[stat_stages] ;		// Of which timed
+	uint64_t cycles[stat_stages] ;		// bch_cycles() ticks spent in each stage by those
+	uint64_t errors[tt_max + 2] ;		// Codewords by errors corrected, [tt + 1] unable to decode
+	uint64_t bm_iterations ;		// Key equation iterations
+	uint64_t chien_points ;			// Positions evaluated by the Chien search
+} bch_stats ;
+
+static inline uint64_t bch_cycles(void)
+/* Time stamp counter, or nanoseconds where there is none */
+#if defined(__x86_64__) || defined(__i386__)
+{	return __builtin_ia32_rdtsc() ;
+}
+#else
+{	struct timespec ts ;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts) ;
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec ;
+}
+#endif
+
+typedef struct {
+	int mm, nn, kk, tt, rr ;	// BCH code parameters
+	int nn_shorten, kk_shorten ;	// Shortened BCH code
+	int Parallel ;			// Parallel processing
+	int flags ;			// BCH_* options
+	int Verbose ;			// Mode indicator
+	int p[mm_max + 1] ;		// Primitive polynomial
+	int *alpha_to, *index_of ;	// Galois field, nn + 1 entries each
+	int *gg ;			// Generator polynomial, rr + 1 coefficients
+	int *T_G_R_row, *T_G_R_col ;	// Parallel lookahead table T_G_R, rr x rr (BCH_LOOKAHEAD):
+					// columns of the set entries of row r at T_G_R_col[T_G_R_row[r]] ..
+	int rem_words ;			// 64-bit words used by the packed remainder
+	uint64_t *rem_table ;		// Slicing-by-8 remainder tables
+	int (*syn_table)[256] ;		// Odd syndrome contribution of each byte value (BCH_DIRECT,
+					// and S(x) to syndromes on the scalar path)
+	int *quad_table ;		// A root y of y**2 + y = c, or -1 if there is none
+	const gf_kernel *gf ;		// Vector kernel, NULL for scalar
+	const bch_fixed *fixed ;	// Codec specialised to this code, or NULL
+	gf_const (*syn_k)[6] ;		// alpha**(32i), then alpha**(16i) .. alpha**i to fold the lanes
+	gf_const *chien_k ;		// alpha**(32j), Chien step of term j
+	void *cache_map ;		// Cache file the tables above are mapped from (BCH_CACHE)
+	size_t cache_len ;
+	void *arena ;			// Blocks all other tables are carved from
+} bch_ctx ;
+
+/* Sized for the code by bch_work_new() */
+typedef struct {
+	gf_planes *syn_in ;		// S(x), 32 bits per step, (rr + 31) / 32 steps
+	gf_planes *chien_term ;		// Chien terms elp[j] * alpha**(ij) of 32 positions, tt + 1
+	int *bb ;			// Syndrome polynomial / parity checks, rr
+	int *s ;			// Syndrome values, 2 tt + 1
+	int syn_error ;			// Syndrome error indicator
+	int count ;			// Number of errors
+	int *location ;			// Error locations, storage form after bch_decode(), tt
+	int bm_iterations ;		// Iterations of the last bch_key_equation()
+	int chien_points ;		// Positions evaluated by the last bch_roots()
+	bch_stats stats ;		// Totals over every bch_decode() (BCH_STATS)
+	uint64_t *slice_data ;		// Data bit i of 64 codewords per word (BCH_LOOKAHEAD)
+} bch_work ;
+
+/* Codec compiled for one fixed (m, t, k), see bch_fixed.c */
+struct bch_fixed {
+	int mm, tt, kk, rr ;
+	// Table driven remainder of the kk / 8 data bytes
+	void (*remainder)(const bch_ctx *ctx, const unsigned char *data, uint64_t *rem) ;
+	// Syndrome polynomial of a codeword into w->bb, or 0 if it is zero
+	int (*syndrome)(const bch_ctx *ctx, bch_work *w, const unsigned char *codeword) ;
+	// Odd syndromes from w->bb, scalar
+	void (*odd_syndromes)(const bch_ctx *ctx, bch_work *w) ;
+} ;
+
+const bch_fixed *bch_fixed_find(const bch_ctx *ctx) ;
+
+/* Code context */
+bch_ctx *bch_init(int m, int t, int k, int parallel, int flags, const char *kernel) ;
+void bch_free(bch_ctx *ctx) ;
+bch_work *bch_work_new(const bch_ctx *ctx) ;
+void bch_work_free(bch_work *w) ;
+
+/* Encode kk_shorten data bits into rr parity bits */
+void bch_encode(const bch_ctx *ctx, bch_work *w, const unsigned char *data, unsigned char *parity) ;
+/* Encode n codewords, data and parity at the given strides in bytes */
+void bch_encode_batch(const bch_ctx *ctx, bch_work *w, const unsigned char *data, int data_stride,
+		      int n, unsigned char *parity, int parity_stride) ;
+/* Correct nn_shorten received bits in place.  Returns the number of errors
+ * corrected, whose positions are left in w->location, or -1 if the codeword
+ * is unable to decode.
+ */
+int bch_decode(const bch_ctx *ctx, bch_work *w, unsigned char *codeword) ;
+/* The stages of bch_decode(), for profiling:  the 2t syndromes into w->s
+ * (returns w->syn_error), the ELP from them (returns its degree, tt + 1 if
+ * there are more than t errors) and its roots into w->location, systematic
+ * form (returns how many).
+ */
+int bch_syndromes(const bch_ctx *ctx, bch_work *w, unsigned char *codeword) ;
+int bch_key_equation(const bch_ctx *ctx, bch_work *w, int *sigma) ;
+int bch_roots(const bch_ctx *ctx, bch_work *w, int deg, const int *sigma) ;
+
+/* Locate the errors of the odd syndromes in w->s alone, storage form, as
+ * bch_decode() would.  Returns how many, or -1.
+ */
+int bch_locate(const bch_ctx *ctx, bch_work *w) ;
+/* Chase-II soft decision decoding of a codeword bch_decode() was unable to
+ * decode, reliability[i] being the confidence in storage bit i (0 the
+ * least), see bch_chase.c.  Returns the number of bits flipped, or -1.
+ */
+#define chase_max  16			// Least reliable bits tried at most
+int bch_chase(const bch_ctx *ctx, bch_work *w, unsigned char *codeword, const unsigned char *reliability, int flips) ;
+
+/* Batch decode on a work-stealing pool of threads, the caller included */
+typedef struct bch_pool bch_pool ;
+bch_pool *bch_pool_new(const bch_ctx *ctx, int threads) ;
+void bch_pool_free(bch_pool *pool) ;
+void bch_decode_batch(bch_pool *pool, unsigned char *codewords, int stride, int n, int *count, int *location) ;
+/* Sum of the BCH_STATS counters of every worker */
+void bch_pool_stats(const bch_pool *pool, bch_stats *sum) ;
+void bch_stats_add(bch_stats *sum, const bch_stats *s) ;
+
+/* Streaming decode:  a reader thread, decode workers and the caller writing
+ * the batches back in input order, see bch_pipe.c
+ */
+typedef struct bch_pipe bch_pipe ;
+// Store up to max codewords, stride bytes apart; returns how many, 0 at the end
+typedef int (*bch_pipe_read)(void *arg, unsigned char *codewords, int max) ;
+// Results of n codewords from codeword first (numbered from 0), as bch_decode_batch()
+typedef void (*bch_pipe_write)(void *arg, long first, int n, unsigned char *codewords, int *count, int *location) ;
+bch_pipe *bch_pipe_new(const bch_ctx *ctx, int workers, int batch) ;
+void bch_pipe_free(bch_pipe *pipe) ;
+long bch_pipe_run(bch_pipe *pipe, bch_pipe_read source, bch_pipe_write sink, void *arg) ;
+void bch_pipe_stats(const bch_pipe *pipe, bch_stats *sum) ;
+
+/* NAND pages of several sectors, one codeword each, see bch_page.c.  The
+ * data of sector i is at data_offset + i * data_stride bytes into the page
+ * and its (rr + 7) / 8 parity bytes at parity_offset + i * parity_stride.
+ */
+typedef struct {
+	int sectors, page_bytes ;
+	int data_offset, data_stride ;
+	int parity_offset, parity_stride ;
+} bch_page_layout ;
+typedef struct bch_page bch_page ;
+// Data of every sector, then the spare area:  spare_offset bytes (bad block
+// marker), then the parity of every sector
+void bch_page_layout_spare(const bch_ctx *ctx, bch_page_layout *layout, int sectors, int spare_offset) ;
+// Data of each sector followed by its parity
+void bch_page_layout_interleaved(const bch_ctx *ctx, bch_page_layout *layout, int sectors) ;
+bch_page *bch_page_new(const bch_ctx *ctx, const bch_page_layout *layout, int pages, bch_pool *pool) ;
+void bch_page_free(bch_page *pg) ;
+void bch_page_encode(bch_page *pg, unsigned char *pages, int n) ;
+int bch_page_decode(bch_page *pg, unsigned char *pages, int n, int *count) ;
+
+/* Random numbers of the simulator and the error generator, see bch_rand.c.
+ * Each (seed, stream) pair is an independent xoshiro256** sequence.
+ */
+typedef struct {
+	uint64_t s[4] ;
+} bch_rng ;
+
+static inline uint64_t bch_rng_next(bch_rng *r)
+{	uint64_t x, t ;
+
+	x = r->s[1] * 5 ;
+	x = ((x << 7) | (x >> 57)) * 9 ;
+	t = r->s[1] << 17 ;
+	r->s[2] ^= r->s[0] ;
+	r->s[3] ^= r->s[1] ;
+	r->s[1] ^= r->s[2] ;
+	r->s[0] ^= r->s[3] ;
+	r->s[2] ^= t ;
+	r->s[3] = (r->s[3] << 45) | (r->s[3] >> 19) ;
+	return x ;
+}
+
+void bch_rng_seed(bch_rng *r, uint64_t seed, uint64_t stream) ;
+uint64_t bch_rng_below(bch_rng *r, uint64_t n) ;
+long bch_rng_gap(bch_rng *r, double log_q) ;
+void bch_rng_sample(bch_rng *r, int n, int w, int *pos) ;
+
+/* Vector kernels */
+int gf_select_kernel(const char *name, int mm, const gf_kernel **kern) ;
+void gf_prepare_const(const bch_ctx *ctx, gf_const *k, int c) ;
+
+/* Code construction */
+void gen_primitive_poly(bch_ctx *ctx) ;
+void generate_gf(bch_ctx *ctx) ;
+int gen_poly(bch_ctx *ctx) ;
+int gen_lookahead(bch_ctx *ctx) ;
+int gen_remainder_tables(bch_ctx *ctx) ;
+static inline int packed_bit(const unsigned char *b, int i)
+{	return (b[i >> 3] >> (7 - (i & 7))) & 1 ;
+}
+
+static inline uint64_t load_be64(const unsigned char *b)
+{	return ((uint64_t)b[0] << 56) | ((uint64_t)b[1] << 48) | ((uint64_t)b[2] << 40) | ((uint64_t)b[3] << 32)
+		| ((uint64_t)b[4] << 24) | ((uint64_t)b[5] << 16) | ((uint64_t)b[6] << 8) | (uint64_t)b[7] ;
+}
+
+static inline void remainder_step(const uint64_t *rem_table, int rem_words, uint64_t *rem, uint64_t in)
+// S(t) = [ S(t-1) + M(t) ] * x**64 mod g(x), one table per byte of the sum
+{	const uint64_t *t ;
+	uint64_t x ;
+	int s, w ;
+	
+	x = rem[0] ^ in ;
+	for (w = 0; w < rem_words - 1; w++)
+		rem[w] = rem[w + 1] ;
+	rem[rem_words - 1] = 0 ;
+	for (s = 0; s < slice_max; s++)
+	{	t = rem_table + ((s * 256) + ((x >> (8 * s)) & 0xff)) * rem_words ;
+		for (w = 0; w < rem_words; w++)
+			rem[w] ^= t[w] ;
+	}
+}
+
+static inline int remainder_zero(const uint64_t *rem, int rem_words)
+{	uint64_t any ;
+	int w ;
+	
+	any = 0 ;
+	for (w = 0; w < rem_words; w++)
+		any |= rem[w] ;
+	return any == 0 ;
+}
+
+void packed_remainder(const bch_ctx *ctx, const unsigned char *Packed_data, int length, uint64_t *rem) ;
+int remainder_byte(const bch_ctx *ctx, const uint64_t *rem, int q) ;
+void remainder_xor_byte(const bch_ctx *ctx, uint64_t *rem, int q, int v) ;
+void remainder_to_bytes(const bch_ctx *ctx, const uint64_t *rem, unsigned char *Packed_parity) ;
+void gen_syndrome_tables(bch_ctx *ctx) ;
+void gen_quadratic_table(bch_ctx *ctx) ;
+void gen_kernel_consts(bch_ctx *ctx) ;
+int cache_load(bch_ctx *ctx, int parallel) ;
+void cache_store(const bch_ctx *ctx, int parallel) ;
+
+/* Hex and bit conversion shared by the tools */
+int hextoint(char hex) ;
+char inttohex(int i) ;
+void print_hex(int length, int Binary_data[length], FILE *std) ;
+void print_hex_low(int length, int Binary_data[length], FILE *std) ;
+void print_hex_bytes(int offset, int length, unsigned char *Packed_data, FILE *std) ;
+void pack_bits(int length, int Binary_data[length], unsigned char *Packed_data) ;
+void unpack_bits(int length, unsigned char *Packed_data, int Binary_data[length]) ;
+
+/* Raw binary input shared by the tools (--binary) */
+typedef struct {
+	int fd ;
+	int record, max ;		// Bytes per record, records per batch
+	unsigned char *map ;		// Mapped regular file, or NULL
+	size_t map_len, pos ;
+	unsigned char *buf ;		// Block buffer when not mapped
+	unsigned char *tail ;		// Partial record at the end of the input
+	size_t tail_len ;
+} bin_input ;
+
+bin_input *bin_open(int fd, int record, int max) ;
+unsigned char *bin_read(bin_input *in, int *n) ;
+void bin_close(bin_input *in) ;
+
+/* Buffered hex text input shared by the tools */
+typedef struct {
+	int fd ;
+	unsigned char *buf ;		// Current block
+	size_t pos, len ;
+	int eof ;			// End of the input reached
+	int comment ;			// Inside { }
+	int in_record ;			// A record read has filled its buffer before the record ended
+} hex_input ;
+
+hex_input *hex_open(int fd) ;
+int hex_read(hex_input *in, unsigned char *Packed_data, int nibbles, int record) ;
+void hex_close(hex_input *in) ;
+
+#endif
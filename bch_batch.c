@@ -0,0 +1,264 @@
+/*******************************************************************************
+*
+*    File Name:  bch_batch.c
+*
+*  Description:  libbch batch decoder on a work-stealing thread pool
+*
+*     Function:   1. bch_pool_new() starts threads - 1 helper threads; the
+*		     calling thread is worker 0.  Each worker has its own
+*		     bch_work.
+*		  2. bch_decode_batch() decodes n codewords in place.  Each
+*		     worker starts on an equal slice of the batch and takes one
+*		     codeword at a time from the front of its slice.  A worker
+*		     whose slice is empty steals the back half of the largest
+*		     slice left, so a few words needing BM and Chien do not
+*		     leave the other cores idle behind a static split.
+*
+*		  A slice is a [lo, hi) pair packed into one 64-bit atomic.
+*		  The owner advances lo and thieves lower hi, both by
+*		  compare-and-swap, so no locks are taken per codeword.
+*		  Results are stored by codeword index and do not depend on
+*		  which worker decoded them.
+*
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "bch.h"
+
+#define slice(lo, hi)  (((uint64_t)(hi) << 32) | (uint32_t)(lo))
+#define slice_lo(r)  ((int)(uint32_t)(r))
+#define slice_hi(r)  ((int)((r) >> 32))
+
+typedef struct {
+	_Atomic uint64_t range ;	// Codewords [lo, hi) left to this worker
+	bch_work *work ;		// Decoder scratch state
+	pthread_t thread ;
+	int index ;
+	bch_pool *pool ;
+} __attribute__((aligned(64))) bch_worker ;
+
+struct bch_pool {
+	const bch_ctx *ctx ;
+	int threads ;
+	bch_worker *worker ;
+	pthread_mutex_t lock ;
+	pthread_cond_t start, done ;	// Batch handed out, batch finished
+	unsigned batch ;		// Batches handed out so far
+	int running ;			// Helper threads still on the batch
+	int quit ;
+	// Current batch
+	unsigned char *codewords ;
+	int stride, n ;
+	int *count, *location ;
+} ;
+
+static int steal(bch_pool *pool, int self)
+/* Move the back half of the largest slice of another worker to our own.
+ * Returns 0 when every slice is empty.
+ */
+{	bch_worker *victim ;
+	uint64_t r ;
+	int i, best, size, lo, hi, take ;
+
+	for (;;)
+	{	best = -1 ;
+		size = 0 ;
+		for (i = 0; i < pool->threads; i++)
+		{	r = atomic_load(&pool->worker[i].range) ;
+			if (i != self && slice_hi(r) - slice_lo(r) > size)
+			{	size = slice_hi(r) - slice_lo(r) ;
+				best = i ;
+			}
+		}
+		if (best < 0)
+			return 0 ;
+
+		victim = &pool->worker[best] ;
+		r = atomic_load(&victim->range) ;
+		lo = slice_lo(r) ;
+		hi = slice_hi(r) ;
+		if (hi <= lo)
+			continue ;
+		take = (hi - lo + 1) / 2 ;
+		if (atomic_compare_exchange_weak(&victim->range, &r, slice(lo, hi - take)))
+		{	atomic_store(&pool->worker[self].range, slice(hi - take, hi)) ;
+			return 1 ;
+		}
+	}
+}
+
+static void run_worker(bch_pool *pool, bch_worker *me)
+{	uint64_t r ;
+	int i, j, lo, hi, tt ;
+
+	tt = pool->ctx->tt ;
+	do
+	{	for (;;)
+		{	r = atomic_load(&me->range) ;
+			lo = slice_lo(r) ;
+			hi = slice_hi(r) ;
+			if (lo >= hi)
+				break ;
+			if (!atomic_compare_exchange_weak(&me->range, &r, slice(lo + 1, hi)))
+				continue ;
+
+			i = lo ;
+			pool->count[i] = bch_decode(pool->ctx, me->work, pool->codewords + (size_t)i * pool->stride) ;
+			if (pool->location)
+				for (j = 0; j < pool->count[i]; j++)
+					pool->location[i * tt + j] = me->work->location[j] ;
+		}
+	} while (steal(pool, me->index)) ;
+}
+
+static void *worker_main(void *arg)
+{	bch_worker *me = arg ;
+	bch_pool *pool = me->pool ;
+	unsigned seen ;
+
+	seen = 0 ;
+	for (;;)
+	{	pthread_mutex_lock(&pool->lock) ;
+		while (pool->batch == seen && !pool->quit)
+			pthread_cond_wait(&pool->start, &pool->lock) ;
+		seen = pool->batch ;
+		pthread_mutex_unlock(&pool->lock) ;
+		if (pool->quit)
+			return NULL ;
+
+		run_worker(pool, me) ;
+
+		pthread_mutex_lock(&pool->lock) ;
+		if (--pool->running == 0)
+			pthread_cond_signal(&pool->done) ;
+		pthread_mutex_unlock(&pool->lock) ;
+	}
+}
+
+bch_pool *bch_pool_new(const bch_ctx *ctx, int threads)
+/* Pool of threads workers, the caller being one of them.  Returns NULL if
+ * out of memory or the threads cannot be started.
+ */
+{	bch_pool *pool ;
+	int i ;
+
+	if (threads < 1)
+		threads = 1 ;
+	pool = calloc(1, sizeof(bch_pool)) ;
+	if (pool == NULL)
+		return NULL ;
+	pool->ctx = ctx ;
+	pool->threads = threads ;
+	if (posix_memalign((void **)&pool->worker, 64, threads * sizeof(bch_worker)) != 0)
+	{	free(pool) ;
+		return NULL ;
+	}
+	memset(pool->worker, 0, threads * sizeof(bch_worker)) ;
+	for (i = 0; i < threads; i++)
+	{	pool->worker[i].index = i ;
+		pool->worker[i].pool = pool ;
+		atomic_init(&pool->worker[i].range, 0) ;
+		pool->worker[i].work = bch_work_new(ctx) ;
+		if (pool->worker[i].work == NULL)
+			goto fail ;
+	}
+
+	pthread_mutex_init(&pool->lock, NULL) ;
+	pthread_cond_init(&pool->start, NULL) ;
+	pthread_cond_init(&pool->done, NULL) ;
+	for (i = 1; i < threads; i++)
+		if (pthread_create(&pool->worker[i].thread, NULL, worker_main, &pool->worker[i]) != 0)
+		{	// Stop the workers already started
+			pool->threads = i ;
+			for (; i < threads; i++)
+				bch_work_free(pool->worker[i].work) ;
+			bch_pool_free(pool) ;
+			return NULL ;
+		}
+	return pool ;
+
+fail:
+	for (i = 0; i < threads; i++)
+		bch_work_free(pool->worker[i].work) ;
+	free(pool->worker) ;
+	free(pool) ;
+	return NULL ;
+}
+
+void bch_pool_free(bch_pool *pool)
+{	int i ;
+
+	if (pool == NULL)
+		return ;
+	pthread_mutex_lock(&pool->lock) ;
+	pool->quit = 1 ;
+	pthread_cond_broadcast(&pool->start) ;
+	pthread_mutex_unlock(&pool->lock) ;
+	for (i = 1; i < pool->threads; i++)
+		pthread_join(pool->worker[i].thread, NULL) ;
+	pthread_mutex_destroy(&pool->lock) ;
+	pthread_cond_destroy(&pool->start) ;
+	pthread_cond_destroy(&pool->done) ;
+	for (i = 0; i < pool->threads; i++)
+		bch_work_free(pool->worker[i].work) ;
+	free(pool->worker) ;
+	free(pool) ;
+}
+
+void bch_decode_batch(bch_pool *pool, unsigned char *codewords, int stride, int n, int *count, int *location)
+/* Decode n codewords, stride bytes apart, in place.  count[i] is the result
+ * of bch_decode() for codeword i; if location is not NULL its error
+ * positions are stored at location[i * tt].
+ */
+{	int i ;
+
+	pool->codewords = codewords ;
+	pool->stride = stride ;
+	pool->n = n ;
+	pool->count = count ;
+	pool->location = location ;
+	for (i = 0; i < pool->threads; i++)
+		atomic_store(&pool->worker[i].range, slice((long)n * i / pool->threads, (long)n * (i + 1) / pool->threads)) ;
+
+	pthread_mutex_lock(&pool->lock) ;
+	pool->running = pool->threads - 1 ;
+	pool->batch++ ;
+	pthread_cond_broadcast(&pool->start) ;
+	pthread_mutex_unlock(&pool->lock) ;
+
+	run_worker(pool, &pool->worker[0]) ;
+
+	pthread_mutex_lock(&pool->lock) ;
+	while (pool->running > 0)
+		pthread_cond_wait(&pool->done, &pool->lock) ;
+	pthread_mutex_unlock(&pool->lock) ;
+}
+
+void bch_stats_add(bch_stats *sum, const bch_stats *s)
+{	int j ;
+
+	sum->codewords += s->codewords ;
+	for (j = 0; j < stat_stages; j++)
+	{	sum->calls[j] += s->calls[j] ;
+		sum->timed[j] += s->timed[j] ;
+		sum->cycles[j] += s->cycles[j] ;
+	}
+	for (j = 0; j < tt_max + 2; j++)
+		sum->errors[j] += s->errors[j] ;
+	sum->bm_iterations += s->bm_iterations ;
+	sum->chien_points += s->chien_points ;
+}
+
+void bch_pool_stats(const bch_pool *pool, bch_stats *sum)
+/* Read between batches for exact totals; read during one, a counter may
+ * miss the codewords in flight.
+ */
+{	int i ;
+
+	memset(sum, 0, sizeof(bch_stats)) ;
+	for (i = 0; i < pool->threads; i++)
+		bch_stats_add(sum, &pool->worker[i].work->stats) ;
+}
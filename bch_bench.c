@@ -0,0 +1,385 @@
+/*******************************************************************************
+*
+*    File Name:  bch_bench.c
+*
+*  Description:  In process benchmark of libbch
+*
+*     Function:   1. Sweeps the codes m = 13 .. 15, t = 4 .. 24, two data
+*		     lengths per field and the syndrome modes (table driven,
+*		     lookahead at two widths P), or the one code given.
+*		  2. Times each codeword through encode, syndromes, the key
+*		     equation, the root search and the whole decode, for every
+*		     error weight 0 .. t.
+*		  3. Writes MB/s of data, codewords/s and the p50 / p99
+*		     latency per codeword as JSON, one record per code, mode,
+*		     stage and weight, so runs of two builds can be diffed.
+*
+*		  Latencies are net of the cost of reading the clock.  Set up
+*		  between the timed calls (restoring the syndromes, copying
+*		  the corrupted codeword) is not counted.
+*
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bch.h"
+
+#define df_n  200		// Codewords per weight
+#define df_out  "bench.json"
+
+typedef struct {
+	const char *name ;
+	int flags ;
+	int parallel ;			// Lookahead width P, or 0 for the -p default
+} bench_mode ;
+
+static bench_mode modes[] = {
+	{ "table", 0, 0 },
+	{ "lookahead", BCH_LOOKAHEAD, 8 },
+	{ "lookahead", BCH_LOOKAHEAD, 32 },
+} ;
+
+static const int sweep_m[] = { 13, 14, 15 } ;
+static const int sweep_t[] = { 4, 8, 16, 24 } ;
+
+static double timer_ns ;		// Cost of one pair of clock reads
+static int records ;			// JSON records written
+static uint64_t rng = 0x9e3779b97f4a7c15ull ;
+
+static inline double now_ns(void)
+{	struct timespec ts ;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts) ;
+	return ts.tv_sec * 1e9 + ts.tv_nsec ;
+}
+
+static uint64_t next_random(void)
+/* xorshift64* */
+{	rng ^= rng >> 12 ;
+	rng ^= rng << 25 ;
+	rng ^= rng >> 27 ;
+	return rng * 0x2545f4914f6cdd1dull ;
+}
+
+static int cmp_double(const void *a, const void *b)
+{	double x = *(const double *)a, y = *(const double *)b ;
+
+	return x < y ? -1 : x > y ;
+}
+
+static void calibrate(void)
+/* Median cost of an empty timed region */
+{	double t[1001], t0 ;
+	int i ;
+
+	for (i = 0; i < 1001; i++)
+	{	t0 = now_ns() ;
+		t[i] = now_ns() - t0 ;
+	}
+	qsort(t, 1001, sizeof(double), cmp_double) ;
+	timer_ns = t[500] ;
+}
+
+static double throughput(const double *lat, int n, int bytes)
+/* MB/s of n codewords of bytes data bytes */
+{	double total ;
+	int i ;
+
+	total = 0 ;
+	for (i = 0; i < n; i++)
+		total += lat[i] > timer_ns ? lat[i] - timer_ns : 0 ;
+	return total > 0 ? (double)n * bytes * 1e3 / total : 0 ;
+}
+
+static void report(FILE *json, const bch_ctx *ctx, const char *mode, const char *stage, int errors,
+		   double *lat, int n, int failures)
+/* One JSON record from the latencies of n codewords */
+{	double mb_s, cw_s, p50, p99 ;
+	int i ;
+
+	mb_s = throughput(lat, n, ctx->kk_shorten / 8) ;
+	cw_s = mb_s * 1e6 / (ctx->kk_shorten / 8) ;
+	for (i = 0; i < n; i++)
+		lat[i] = lat[i] > timer_ns ? lat[i] - timer_ns : 0 ;
+	qsort(lat, n, sizeof(double), cmp_double) ;
+	p50 = lat[(n - 1) / 2] ;
+	p99 = lat[(n - 1) * 99 / 100] ;
+
+	fprintf(json, "%s    {\"m\": %d, \"t\": %d, \"k\": %d, \"P\": %d, \"mode\": \"%s\", \"kernel\": \"%s\", "
+		"\"fixed\": %s, \"stage\": \"%s\", \"errors\": %d, \"codewords\": %d, \"failures\": %d, "
+		"\"mb_s\": %.1f, \"codewords_s\": %.0f, \"p50_ns\": %.0f, \"p99_ns\": %.0f}",
+		records ? ",\n" : "", ctx->mm, ctx->tt, ctx->kk_shorten, ctx->Parallel,
+		mode, ctx->gf ? ctx->gf->name : "scalar", ctx->fixed ? "true" : "false", stage, errors, n, failures,
+		mb_s, cw_s, p50, p99) ;
+	records++ ;
+}
+
+static void corrupt(const bch_ctx *ctx, unsigned char *codeword, int errors)
+/* Flip errors distinct bits of the nn_shorten bit stream */
+{	int pos[tt_max], i, j ;
+
+	for (i = 0; i < errors; i++)
+	{	do
+		{	pos[i] = next_random() % ctx->nn_shorten ;
+			for (j = 0; j < i && pos[j] != pos[i]; j++)
+				;
+		} while (j < i) ;
+		codeword[pos[i] >> 3] ^= 0x80 >> (pos[i] & 7) ;
+	}
+}
+
+static int bench_code(FILE *json, const char *mode, int m, int t, int k, int parallel, int flags,
+		      const char *kernel, int n)
+/* All stages and weights of one code.  Returns -1 if the code is invalid. */
+{	bch_ctx *ctx ;
+	bch_work *w ;
+	unsigned char *clean, *words, *scratch ;
+	int *syn, *sigma, *deg ;
+	double *lat, t0, enc_mb_s, dec_mb_s[2] ;
+	int c, e, i, stride, data_bytes, ttx2, failures ;
+
+	ctx = bch_init(m, t, k, parallel, flags | BCH_CACHE, kernel) ;
+	if (ctx == NULL)
+		return -1 ;
+	w = bch_work_new(ctx) ;
+	data_bytes = ctx->kk_shorten / 8 ;
+	stride = (ctx->nn_shorten + 7) / 8 ;
+	ttx2 = 2 * ctx->tt ;
+	clean = calloc((size_t)n, stride) ;
+	words = malloc((size_t)n * stride) ;
+	scratch = malloc(stride) ;
+	syn = malloc((size_t)n * (ttx2 + 1) * sizeof(int)) ;
+	sigma = malloc((size_t)n * (tt_max + 2) * sizeof(int)) ;
+	deg = malloc((size_t)n * sizeof(int)) ;
+	lat = malloc((size_t)n * sizeof(double)) ;
+	if (w == NULL || clean == NULL || words == NULL || scratch == NULL || syn == NULL
+	 || sigma == NULL || deg == NULL || lat == NULL)
+	{	fprintf(stderr, "### Out of memory.\n\n") ;
+		exit(1) ;
+	}
+
+	// Encode, timed on the clean codewords as they are built
+	for (c = 0; c < n; c++)
+	{	for (i = 0; i < data_bytes; i++)
+			clean[(size_t)c * stride + i] = next_random() ;
+		bch_encode(ctx, w, clean + (size_t)c * stride, clean + (size_t)c * stride + data_bytes) ;
+	}
+	for (c = 0; c < n; c++)
+	{	t0 = now_ns() ;
+		bch_encode(ctx, w, clean + (size_t)c * stride, scratch) ;
+		lat[c] = now_ns() - t0 ;
+	}
+	enc_mb_s = throughput(lat, n, data_bytes) ;
+	report(json, ctx, mode, "encode", 0, lat, n, 0) ;
+
+	for (e = 0; e <= ctx->tt; e++)
+	{	memcpy(words, clean, (size_t)n * stride) ;
+		for (c = 0; c < n; c++)
+			corrupt(ctx, words + (size_t)c * stride, e) ;
+
+		// Syndromes, kept for the key equation
+		failures = 0 ;
+		for (c = 0; c < n; c++)
+		{	t0 = now_ns() ;
+			bch_syndromes(ctx, w, words + (size_t)c * stride) ;
+			lat[c] = now_ns() - t0 ;
+			memcpy(syn + (size_t)c * (ttx2 + 1), w->s, (ttx2 + 1) * sizeof(int)) ;
+			if (w->syn_error != (e > 0))
+				failures++ ;
+		}
+		report(json, ctx, mode, "syndrome", e, lat, n, failures) ;
+
+		if (e > 0)
+		{	// Key equation from the saved syndromes, which it may overwrite
+			failures = 0 ;
+			for (c = 0; c < n; c++)
+			{	memcpy(w->s, syn + (size_t)c * (ttx2 + 1), (ttx2 + 1) * sizeof(int)) ;
+				t0 = now_ns() ;
+				deg[c] = bch_key_equation(ctx, w, sigma + (size_t)c * (tt_max + 2)) ;
+				lat[c] = now_ns() - t0 ;
+				if (deg[c] != e)
+					failures++ ;
+			}
+			report(json, ctx, mode, "bm", e, lat, n, failures) ;
+
+			// Roots of the ELPs just found
+			failures = 0 ;
+			for (c = 0; c < n; c++)
+			{	if (deg[c] > ctx->tt)
+				{	lat[c] = 0 ;
+					failures++ ;
+					continue ;
+				}
+				t0 = now_ns() ;
+				i = bch_roots(ctx, w, deg[c], sigma + (size_t)c * (tt_max + 2)) ;
+				lat[c] = now_ns() - t0 ;
+				if (i != deg[c])
+					failures++ ;
+			}
+			report(json, ctx, mode, "chien", e, lat, n, failures) ;
+		}
+
+		// End to end, on a copy as the codeword is corrected in place
+		failures = 0 ;
+		for (c = 0; c < n; c++)
+		{	memcpy(scratch, words + (size_t)c * stride, stride) ;
+			t0 = now_ns() ;
+			i = bch_decode(ctx, w, scratch) ;
+			lat[c] = now_ns() - t0 ;
+			if (i != e || memcmp(scratch, clean + (size_t)c * stride, stride) != 0)
+				failures++ ;
+		}
+		if (e == 0 || e == ctx->tt)
+			dec_mb_s[e != 0] = throughput(lat, n, data_bytes) ;
+		report(json, ctx, mode, "decode", e, lat, n, failures) ;
+		if (failures)
+			fprintf(stderr, "### m = %d, t = %d, k = %d, %s:  %d of %d codewords with %d errors failed to decode.\n",
+				m, t, k, mode, failures, n, e) ;
+	}
+
+	fprintf(stdout, "{ m = %2d, t = %2d, k = %5d, %-9s P = %2d, %-6s%s }  encode %8.1f MB/s, decode %8.1f MB/s clean, %8.1f MB/s at t errors\n",
+		ctx->mm, ctx->tt, ctx->kk_shorten, mode, ctx->Parallel,
+		ctx->gf ? ctx->gf->name : "scalar", ctx->fixed ? " fixed" : "", enc_mb_s, dec_mb_s[0], dec_mb_s[1]) ;
+	fflush(stdout) ;
+
+	free(clean) ;
+	free(words) ;
+	free(scratch) ;
+	free(syn) ;
+	free(sigma) ;
+	free(deg) ;
+	free(lat) ;
+	bch_work_free(w) ;
+	bch_free(ctx) ;
+	return 0 ;
+}
+
+static int sweep(int *list, const int *values, int count, int only)
+/* The values to run:  only, if set, else the default sweep */
+{	int i, n ;
+
+	if (only)
+	{	list[0] = only ;
+		return 1 ;
+	}
+	for (i = n = 0; i < count; i++)
+		list[n++] = values[i] ;
+	return n ;
+}
+
+int main(int argc, char **argv)
+{	int i, j, mi, ti, ki, Help ;
+	int mm, tt, kk, Parallel, n, flags ;
+	int ms[8], ts[8], ks[2], nm, nt, nk ;
+	const char *Kernel, *Output ;
+	const gf_kernel *kern ;
+	FILE *json ;
+
+	fprintf(stderr, "# libbch benchmark.  Use -h for details.\n\n") ;
+
+	Help = 0 ;
+	mm = tt = kk = Parallel = 0 ;
+	n = df_n ;
+	flags = 0 ;
+	Kernel = NULL ;
+	Output = df_out ;
+	for (i = 1; i < argc; i++)
+	{	if (argv[i][0] == '-')
+		{	switch (argv[i][1])
+			{	case 'm': mm = i + 1 < argc ? atoi(argv[++i]) : -1 ;
+					  break ;
+				case 't': tt = i + 1 < argc ? atoi(argv[++i]) : -1 ;
+					  break ;
+				case 'k': kk = i + 1 < argc ? atoi(argv[++i]) : -1 ;
+					  break ;
+				case 'p': Parallel = i + 1 < argc ? atoi(argv[++i]) : -1 ;
+					  break ;
+				case 'n': n = i + 1 < argc ? atoi(argv[++i]) : -1 ;
+					  break ;
+				case 'g': Kernel = i + 1 < argc ? argv[++i] : "" ;
+					  break ;
+				case 'o': Output = i + 1 < argc ? argv[++i] : "" ;
+					  break ;
+				case 'i': flags |= BCH_INVERSIONLESS ;
+					  break ;
+				default: Help = 1 ;
+			}
+		}
+		else
+			Help = 1 ;
+	}
+	if (mm < 0 || tt < 0 || kk < 0 || kk % 8 || Parallel < 0 || n < 1 || *Output == 0)
+		Help = 1 ;
+	else if (gf_select_kernel(Kernel, mm ? mm : df_m, &kern) < 0)
+	{	fprintf(stderr, "### Unknown or unsupported kernel %s.\n\n", Kernel) ;
+		Help = 1 ;
+	}
+
+	if (Help)
+	{	fprintf(stdout, "# Usage %s:  libbch benchmark\n", argv[0]) ;
+		fprintf(stdout, "    -h:  This help message\n") ;
+		fprintf(stdout, "    -m <field>:  Only this Galois field.  Default sweeps 13, 14 and 15.\n") ;
+		fprintf(stdout, "    -t <correct>:  Only this correction power.  Default sweeps 4, 8, 16 and\n") ;
+		fprintf(stdout, "         24, up to the largest supported (%d).\n", tt_max) ;
+		fprintf(stdout, "    -k <data bits>:  Only this data length, which must divide 8.  Default\n") ;
+		fprintf(stdout, "         sweeps 2048 and 4096 times 2^(m-13).\n") ;
+		fprintf(stdout, "    -p <parallel>:  Only this lookahead width.  Default sweeps 8 and 32;\n") ;
+		fprintf(stdout, "         the table driven syndromes run at P = %d.\n", df_p) ;
+		fprintf(stdout, "    -i   Solve the key equation with the inversionless Berlekamp-Massey\n") ;
+		fprintf(stdout, "         algorithm.  Default disabled.\n") ;
+		fprintf(stdout, "    -g <kernel>:  GF(2^m) kernel:  scalar, ssse3, avx2 or gfni.  Default is\n") ;
+		fprintf(stdout, "         the best the CPU supports.\n") ;
+		fprintf(stdout, "    -n <codewords>:  Codewords timed per stage and error weight.  Default = %d\n", df_n) ;
+		fprintf(stdout, "    -o <file>:  JSON report.  Default = %s\n", df_out) ;
+		fprintf(stdout, "    <stdout>:  MB/s of encode and decode per code.\n") ;
+		fprintf(stdout, "    <stderr>:  information about the process as well as error messages\n") ;
+		fprintf(stdout, "    Stages:  encode, syndrome, bm (key equation), chien (roots of the ELP,\n") ;
+		fprintf(stdout, "         closed form up to degree 4) and decode, each for 0 .. t errors.\n") ;
+		return 0 ;
+	}
+
+	json = fopen(Output, "w") ;
+	if (json == NULL)
+	{	fprintf(stderr, "### Cannot write %s.\n\n", Output) ;
+		return 1 ;
+	}
+	if (Parallel)
+	{	modes[1].parallel = Parallel ;
+		modes[2].parallel = 0 ;
+	}
+	nm = sweep(ms, sweep_m, sizeof(sweep_m) / sizeof(sweep_m[0]), mm) ;
+	nt = sweep(ts, sweep_t, sizeof(sweep_t) / sizeof(sweep_t[0]), tt) ;
+	calibrate() ;
+	fprintf(json, "{\n  \"timer_ns\": %.0f,\n  \"codewords\": %d,\n  \"key_equation\": \"%s\",\n  \"results\": [\n",
+		timer_ns, n, flags & BCH_INVERSIONLESS ? "inversionless" : "berlekamp-massey") ;
+
+	for (mi = 0; mi < nm; mi++)
+		for (ti = 0; ti < nt; ti++)
+		{	// The default sweep stops at the largest t supported
+			if (!tt && ts[ti] > tt_max)
+				continue ;
+			// 256 and 512 bytes at m = 13, doubling with the field
+			ks[0] = ms[mi] >= 13 ? 2048 << (ms[mi] - 13) : 2048 >> (13 - ms[mi]) ;
+			ks[1] = 2 * ks[0] ;
+			if (kk)
+				ks[0] = kk ;
+			nk = kk ? 1 : 2 ;
+			for (ki = 0; ki < nk; ki++)
+				for (j = 0; j < (int)(sizeof(modes) / sizeof(modes[0])); j++)
+				{	if (modes[j].flags & BCH_LOOKAHEAD && modes[j].parallel == 0)
+						continue ;
+					if (bench_code(json, modes[j].name, ms[mi], ts[ti], ks[ki],
+						       modes[j].parallel ? modes[j].parallel : df_p,
+						       modes[j].flags | flags, Kernel, n) < 0)
+						fprintf(stderr, "### m = %d, t = %d, k = %d is not a supported code.\n",
+							ms[mi], ts[ti], ks[ki]) ;
+				}
+		}
+
+	fprintf(json, "\n  ]\n}\n") ;
+	fclose(json) ;
+	fprintf(stderr, "# %d results written to %s.\n", records, Output) ;
+	return 0 ;
+}
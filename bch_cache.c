@@ -0,0 +1,285 @@
+/*******************************************************************************
+*
+*    File Name:  bch_cache.c
+*
+*  Description:  Persistent cache of the code construction tables (BCH_CACHE)
+*
+*     Function:   1. cache_load() maps a cache file read only and points the
+*		     code context at its tables, skipping generate_gf(),
+*		     gen_poly(), gen_lookahead(), gen_remainder_tables() and
+*		     gen_quadratic_table().
+*		  2. cache_store() writes the tables of a freshly built context
+*		     for the next run.
+*
+*		  A file holds one code, keyed by (m, t, primitive polynomial,
+*		  lookahead width P), with P = 0 when BCH_LOOKAHEAD is not used.
+*		  Its name carries the key and its header repeats it together
+*		  with the table sizes and a checksum of the whole file, so a
+*		  stale, foreign or damaged file is ignored.
+*		  Files are written under a temporary name and renamed, so a
+*		  reader never sees a partial file, and are shared through the
+*		  page cache by every process using the same code.
+*
+*		  The directory is $BCH_CACHE_DIR, else $XDG_CACHE_HOME/bch,
+*		  else $HOME/.cache/bch.  An empty $BCH_CACHE_DIR disables the
+*		  cache.  Failures are silent:  the tables are then built as
+*		  without the cache.
+*
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "bch.h"
+
+#define cache_magic  "BCHTAB\r\n"
+#define cache_version  3
+#define cache_align  64
+
+typedef struct {
+	char magic[8] ;
+	uint32_t version, int_size, order ;	// Layout of the writer
+	int32_t mm, tt, poly, key_parallel ;	// Key
+	int32_t rr, kk, Parallel, rem_words, nnz ;	// Parallel as clamped to rr
+	uint64_t alpha_to, index_of, gg, rem_table, quad_table ;	// Table offsets
+	uint64_t T_G_R_row, T_G_R_col ;
+	uint64_t size ;
+	uint64_t checksum ;		// Of the file, this field as 0
+} cache_header ;
+
+static int cache_poly(const bch_ctx *ctx)
+/* Primitive polynomial as an integer, bit i the coefficient of X**i */
+{	int i, poly ;
+
+	poly = 0 ;
+	for (i = 0; i <= ctx->mm; i++)
+		if (ctx->p[i])
+			poly |= 1 << i ;
+	return poly ;
+}
+
+#define cache_head  ((sizeof(cache_header) + cache_align - 1) / cache_align * cache_align)
+
+static void checksum_block(uint64_t *h, const unsigned char *p, uint64_t bytes)
+/* Four independent lanes keep the multiplies pipelined over tables of
+ * several MB.  bytes is a multiple of 32.
+ */
+{	uint64_t off, w ;
+	int i ;
+
+	for (off = 0; off < bytes; off += 32)
+		for (i = 0; i < 4; i++)
+		{	memcpy(&w, p + off + 8 * i, 8) ;
+			h[i] = (h[i] ^ w) * 0xff51afd7ed558ccdull ;
+			h[i] ^= h[i] >> 32 ;
+		}
+}
+
+static uint64_t cache_checksum(const unsigned char *map, uint64_t size)
+/* Hash of a whole file of size bytes, a multiple of cache_align, its own
+ * checksum field taken as 0:  the header says how the tables are read,
+ * so it is covered as well.
+ */
+{	unsigned char head[cache_head] ;
+	uint64_t h[4] ;
+	int i ;
+
+	memcpy(head, map, cache_head) ;
+	memset(head + offsetof(cache_header, checksum), 0, sizeof(uint64_t)) ;
+	for (i = 0; i < 4; i++)
+		h[i] = 0x9e3779b97f4a7c15ull * (i + 1) ;
+	checksum_block(h, head, cache_head) ;
+	checksum_block(h, map + cache_head, size - cache_head) ;
+	return h[0] ^ (h[1] << 1 | h[1] >> 63) ^ (h[2] << 2 | h[2] >> 62) ^ (h[3] << 3 | h[3] >> 61) ;
+}
+
+static int cache_key(const bch_ctx *ctx, int parallel)
+/* Lookahead width of the key, 0 without BCH_LOOKAHEAD */
+{	return ctx->flags & BCH_LOOKAHEAD ? parallel : 0 ;
+}
+
+static int cache_path(const bch_ctx *ctx, int parallel, char *path, size_t len, int make_dir)
+/* File name of the cache of ctx.  Returns -1 if the cache is disabled. */
+{	char dir[4096] ;
+	const char *env ;
+	int n ;
+
+	if ((env = getenv("BCH_CACHE_DIR")) != NULL)
+	{	if (*env == 0)
+			return -1 ;
+		if (snprintf(dir, sizeof(dir), "%s", env) >= (int)sizeof(dir))
+			return -1 ;
+	}
+	else if ((env = getenv("XDG_CACHE_HOME")) != NULL && *env)
+	{	if (snprintf(dir, sizeof(dir), "%s/bch", env) >= (int)sizeof(dir))
+			return -1 ;
+	}
+	else if ((env = getenv("HOME")) != NULL && *env)
+	{	snprintf(dir, sizeof(dir), "%s/.cache", env) ;
+		if (make_dir)
+			mkdir(dir, 0755) ;
+		if (snprintf(dir, sizeof(dir), "%s/.cache/bch", env) >= (int)sizeof(dir))
+			return -1 ;
+	}
+	else
+		return -1 ;
+	if (make_dir)
+		mkdir(dir, 0755) ;
+
+	// A cut off name could be the file of another code
+	n = snprintf(path, len, "%s/bch-m%d-t%d-p%x-P%d.tab", dir, ctx->mm, ctx->tt, cache_poly(ctx),
+		     cache_key(ctx, parallel)) ;
+	return n < 0 || (size_t)n >= len ? -1 : 0 ;
+}
+
+static void cache_layout(cache_header *h, int nn)
+/* Table offsets and file size from the code parameters in h */
+{	uint64_t off ;
+
+#define place(field, bytes)  (h->field = off, off = (off + (bytes) + cache_align - 1) / cache_align * cache_align)
+	off = cache_head ;
+	place(alpha_to, (uint64_t)(nn + 1) * sizeof(int)) ;
+	place(index_of, (uint64_t)(nn + 1) * sizeof(int)) ;
+	place(gg, (uint64_t)(h->rr + 1) * sizeof(int)) ;
+	place(rem_table, (uint64_t)slice_max * 256 * h->rem_words * sizeof(uint64_t)) ;
+	place(quad_table, (uint64_t)(nn + 1) * sizeof(int)) ;
+	place(T_G_R_row, h->key_parallel ? (uint64_t)(h->rr + 1) * sizeof(int) : 0) ;
+	place(T_G_R_col, (uint64_t)h->nnz * sizeof(int)) ;
+#undef place
+	h->size = off ;
+}
+
+int cache_load(bch_ctx *ctx, int parallel)
+/* Point ctx at the tables of its cache file, parallel being the lookahead
+ * width asked for.  Needs mm, nn, tt, p[] and flags set.  Returns -1,
+ * leaving ctx untouched, if there is no valid cache file.
+ */
+{	char path[4096] ;
+	cache_header h ;
+	const cache_header *f ;
+	struct stat st ;
+	unsigned char *map ;
+	int fd ;
+
+	if (cache_path(ctx, parallel, path, sizeof(path), 0) < 0)
+		return -1 ;
+	fd = open(path, O_RDONLY) ;
+	if (fd < 0)
+		return -1 ;
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(cache_header))
+	{	close(fd) ;
+		return -1 ;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0) ;
+	close(fd) ;
+	if (map == MAP_FAILED)
+		return -1 ;
+
+	// Check the key and recompute the layout rather than trust the offsets
+	f = (const cache_header *)map ;
+	memset(&h, 0, sizeof(h)) ;
+	h.key_parallel = cache_key(ctx, parallel) ;
+	h.rr = f->rr ;
+	h.rem_words = f->rem_words ;
+	h.nnz = f->nnz ;
+	if (memcmp(f->magic, cache_magic, 8) != 0 || f->version != cache_version
+	 || f->int_size != sizeof(int) || f->order != 0x01020304
+	 || f->mm != ctx->mm || f->tt != ctx->tt || f->poly != cache_poly(ctx) || f->key_parallel != h.key_parallel
+	 || f->rr < 1 || f->rr > rr_max || f->rem_words != (f->rr + 63) / 64
+	 || f->nnz < 0 || f->nnz > (h.key_parallel ? f->rr * f->rr : 0)
+	 || (h.key_parallel && (f->Parallel < 1 || f->Parallel > f->rr)))
+		goto fail ;
+	cache_layout(&h, ctx->nn) ;
+	if (h.size != f->size || h.size != (uint64_t)st.st_size
+	 || h.alpha_to != f->alpha_to || h.T_G_R_col != f->T_G_R_col)
+		goto fail ;
+	// The tables index one another, so a damaged file must not be used.
+	// A consistent one still has to describe a code bch_init() accepts.
+	if (cache_checksum(map, h.size) != f->checksum
+	 || f->kk != ctx->nn - f->rr || f->kk < 4 || ((const int *)(map + h.gg))[f->rr] != 1)
+		goto fail ;
+
+	ctx->rr = f->rr ;
+	ctx->kk = f->kk ;
+	ctx->rem_words = f->rem_words ;
+	ctx->gg = (int *)(map + h.gg) ;
+	ctx->alpha_to = (int *)(map + h.alpha_to) ;
+	ctx->index_of = (int *)(map + h.index_of) ;
+	ctx->rem_table = (uint64_t *)(map + h.rem_table) ;
+	ctx->quad_table = (int *)(map + h.quad_table) ;
+	if (h.key_parallel)
+	{	ctx->Parallel = f->Parallel ;
+		ctx->T_G_R_row = (int *)(map + h.T_G_R_row) ;
+		ctx->T_G_R_col = (int *)(map + h.T_G_R_col) ;
+	}
+	ctx->cache_map = map ;
+	ctx->cache_len = st.st_size ;
+	return 0 ;
+
+fail:
+	munmap(map, st.st_size) ;
+	return -1 ;
+}
+
+void cache_store(const bch_ctx *ctx, int parallel)
+/* Write the cache file of a context built without it */
+{	char path[4096], temp[4200] ;
+	cache_header h ;
+	unsigned char *buf ;
+	int fd, nnz ;
+	size_t done ;
+	ssize_t n ;
+
+	if (cache_path(ctx, parallel, path, sizeof(path), 1) < 0)
+		return ;
+
+	memset(&h, 0, sizeof(h)) ;
+	memcpy(h.magic, cache_magic, 8) ;
+	h.version = cache_version ;
+	h.int_size = sizeof(int) ;
+	h.order = 0x01020304 ;
+	h.mm = ctx->mm ;
+	h.tt = ctx->tt ;
+	h.poly = cache_poly(ctx) ;
+	h.key_parallel = cache_key(ctx, parallel) ;
+	h.rr = ctx->rr ;
+	h.kk = ctx->kk ;
+	h.Parallel = ctx->Parallel ;
+	h.rem_words = ctx->rem_words ;
+	nnz = h.key_parallel ? ctx->T_G_R_row[ctx->rr] : 0 ;
+	h.nnz = nnz ;
+	cache_layout(&h, ctx->nn) ;
+
+	buf = calloc(1, h.size) ;
+	if (buf == NULL)
+		return ;
+	memcpy(buf + h.alpha_to, ctx->alpha_to, (ctx->nn + 1) * sizeof(int)) ;
+	memcpy(buf + h.index_of, ctx->index_of, (ctx->nn + 1) * sizeof(int)) ;
+	memcpy(buf + h.gg, ctx->gg, (ctx->rr + 1) * sizeof(int)) ;
+	memcpy(buf + h.rem_table, ctx->rem_table, (size_t)slice_max * 256 * ctx->rem_words * sizeof(uint64_t)) ;
+	memcpy(buf + h.quad_table, ctx->quad_table, (ctx->nn + 1) * sizeof(int)) ;
+	if (h.key_parallel)
+	{	memcpy(buf + h.T_G_R_row, ctx->T_G_R_row, (ctx->rr + 1) * sizeof(int)) ;
+		memcpy(buf + h.T_G_R_col, ctx->T_G_R_col, (size_t)nnz * sizeof(int)) ;
+	}
+
+	memcpy(buf, &h, sizeof(h)) ;
+	h.checksum = cache_checksum(buf, h.size) ;
+	memcpy(buf, &h, sizeof(h)) ;
+
+	snprintf(temp, sizeof(temp), "%s.%d", path, (int)getpid()) ;
+	fd = open(temp, O_WRONLY | O_CREAT | O_EXCL, 0644) ;
+	if (fd >= 0)
+	{	for (done = 0; done < h.size; done += n)
+			if ((n = write(fd, buf + done, h.size - done)) <= 0)
+				break ;
+		if (close(fd) == 0 && done == h.size)
+			rename(temp, path) ;
+		unlink(temp) ;
+	}
+	free(buf) ;
+}
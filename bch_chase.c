@@ -0,0 +1,119 @@
+/*******************************************************************************
+*
+*    File Name:  bch_chase.c
+*
+*  Description:  libbch soft decision decoding:  Chase-II over the least
+*		  reliable bits of a codeword the hard decoder gave up on
+*
+*     Function:   1. Pick the flips least reliable bits of the codeword.
+*		  2. Run through the 2**flips - 1 test patterns on them in
+*		     Gray code order, so each pattern differs from the last in
+*		     one bit and its odd syndromes are updated with t XORs
+*		     rather than recomputed from the codeword.
+*		  3. Decode each pattern with bch_locate():  the closed form,
+*		     Berlekamp-Massey and Chien stages of bch_decode().
+*		  4. Keep the candidate flipping the least total reliability,
+*		     fewer bits on a tie, and apply it to the codeword.
+*
+*		  A bit i of r(x) flipped adds alpha**(i j) to syndrome j.
+*		  Storage bit b is the coefficient of x**(b + r) in the data,
+*		  of x**(b - k) in the parity.
+*
+*   References:
+*		  1. A class of algorithms for decoding block codes with
+*		     channel measurement information, Chase, 1972
+*
+*******************************************************************************/
+
+#include <string.h>
+#include "bch.h"
+
+int bch_chase(const bch_ctx *ctx, bch_work *w, unsigned char *codeword, const unsigned char *reliability, int flips)
+/* Correct the codeword in place if a test pattern decodes.  Returns the
+ * number of bits flipped, pattern and corrections together, or -1 if none
+ * decodes.  w->location is left undefined.
+ */
+{	int tt = ctx->tt, nn = ctx->nn, nn_shorten = ctx->nn_shorten ;
+	int pos[chase_max] ;			// Least reliable bits, storage form
+	int step[chase_max][tt_max] ;		// Odd syndromes of each one alone
+	int s[tt_max] ;				// Odd syndromes of the current pattern
+	int best_location[tt_max] ;
+	unsigned mask, best_mask, bit ;
+	long metric, m, best_metric ;
+	int n, i, j, k, e, count, flipped, best_count, best_flipped ;
+
+	if (flips > chase_max)
+		flips = chase_max ;
+	// Insertion into a short sorted list:  flips is small and this only
+	// runs on a hard failure
+	n = 0 ;
+	for (j = 0; j < nn_shorten && flips > 0; j++)
+	{	if (n == flips && reliability[j] >= reliability[pos[n - 1]])
+			continue ;
+		for (i = n < flips ? n++ : n - 1; i > 0 && reliability[pos[i - 1]] > reliability[j]; i--)
+			pos[i] = pos[i - 1] ;
+		pos[i] = j ;
+	}
+	if (n == 0)
+		return -1 ;
+
+	bch_syndromes(ctx, w, codeword) ;
+	for (i = 0; i < tt; i++)
+		s[i] = w->s[2 * i + 1] ;
+	for (k = 0; k < n; k++)
+	{	e = pos[k] < ctx->kk_shorten ? pos[k] + ctx->rr : pos[k] - ctx->kk_shorten ;
+		for (i = 0; i < tt; i++)
+			step[k][i] = ctx->alpha_to[(int)((long)e * (2 * i + 1) % nn)] ;
+	}
+
+	mask = 0 ;
+	metric = 0 ;
+	best_mask = 0 ;
+	best_metric = -1 ;
+	best_count = 0 ;
+	best_flipped = 0 ;
+	for (j = 1; j < 1 << n; j++)
+	{	// Gray code:  pattern j differs from pattern j - 1 in bit k
+		k = __builtin_ctz(j) ;
+		bit = 1u << k ;
+		mask ^= bit ;
+		metric += mask & bit ? reliability[pos[k]] : -reliability[pos[k]] ;
+		for (i = 0; i < tt; i++)
+		{	s[i] ^= step[k][i] ;
+			w->s[2 * i + 1] = s[i] ;
+		}
+		if ((count = bch_locate(ctx, w)) < 0)
+			continue ;
+
+		// A correction of a pattern bit undoes it
+		m = metric ;
+		flipped = __builtin_popcount(mask) + count ;
+		for (i = 0; i < count; i++)
+		{	for (k = 0; k < n; k++)
+				if (pos[k] == w->location[i] && (mask & 1u << k))
+					break ;
+			if (k < n)
+			{	m -= reliability[w->location[i]] ;
+				flipped -= 2 ;
+			}
+			else
+				m += reliability[w->location[i]] ;
+		}
+		if (best_metric < 0 || m < best_metric || (m == best_metric && flipped < best_flipped))
+		{	best_metric = m ;
+			best_mask = mask ;
+			best_flipped = flipped ;
+			best_count = count ;
+			memcpy(best_location, w->location, count * sizeof(int)) ;
+		}
+	}
+	if (best_metric < 0)
+		return -1 ;
+
+	for (k = 0; k < n; k++)
+		if (best_mask & 1u << k)
+			codeword[pos[k] >> 3] ^= 0x80 >> (pos[k] & 7) ;
+	for (i = 0; i < best_count; i++)
+		codeword[best_location[i] >> 3] ^= 0x80 >> (best_location[i] & 7) ;
+	return best_flipped ;
+}
@@ -0,0 +1,1005 @@
+/*******************************************************************************
+*
+*    File Name:  bch_decode.c
+*
+*  Description:  libbch decoder
+*
+*     Function:   1. Syndromes:  table driven remainder (default), bit-serial
+*		     lookahead matrix (BCH_LOOKAHEAD) or byte-wise direct
+*		     evaluation (BCH_DIRECT); scalar or vector kernel
+*		  2. Closed form decode of one and two errors
+*		  3. Berlekamp-Massey, or its inversionless form
+*		     (BCH_INVERSIONLESS)
+*		  4. Closed form roots up to degree 4, Chien search above
+*
+*   References: 
+* 		  1. Error Control Coding, Lin & Costello, 2nd Ed., 2004
+* 		  2. Error Control Codes, Blahut, 1983
+*
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include "bch.h"
+
+static inline int received_bit(const bch_ctx *ctx, const unsigned char *codeword, int i) {
+/* Bit i of r(x):  the parity b0 .. b(r-1) first, then the data */
+	if (i < ctx->rr)
+		return packed_bit(codeword, ctx->kk_shorten + i) ;
+	return packed_bit(codeword, i - ctx->rr) ;
+}
+
+static int parallel_syndrome(const bch_ctx *ctx, bch_work *w, const unsigned char *codeword) {
+/* Parallel computation of 2t syndromes.
+ * Use the same lookahead matrix T_G_R of parallel computation of parity check bits.
+ * The incoming streams are fed into registers from left hand; substream i of
+ * step iii is received bit i + iii * Parallel, read from the packed codeword.
+ * Returns 0 if S(x) is zero.
+ */
+	int i, j, iii, Temp, bb_temp[rr_max], any ;
+	int loop_count ;
+	int rr = ctx->rr, Parallel = ctx->Parallel, nn_shorten = ctx->nn_shorten ;
+	int *bb = w->bb ;
+	const int *row = ctx->T_G_R_row, *col = ctx->T_G_R_col ;
+
+	// Determine the number of loops required for parallelism.  
+	loop_count = (nn_shorten + Parallel - 1) / Parallel ;
+	
+	// Initialize the parity bits.
+	for (i = 0; i < rr; i++)
+		bb[i] = 0;
+	
+	// Compute syndrome polynomial: S(x) = C(x) mod g(x)
+	// S(t) = T_G_R S(t-1) + R(t) 
+	// Ref: L&C, pp. 225, Fig. 6.11
+	for (iii = loop_count - 1; iii >= 0; iii--) {
+		for (i = 0; i < rr; i++) {
+			Temp = 0;
+			for (j = row[i]; j < row[i + 1]; j++) 
+				Temp ^= bb[col[j]] ;
+			bb_temp[i] = Temp;
+		}
+		
+		for (i = 0; i < rr; i++)
+			bb[i] = bb_temp[i];
+		
+		for (i = 0; i < Parallel; i++)
+			if (i + iii * Parallel < nn_shorten)
+				bb[i] = bb[i] ^ received_bit(ctx, codeword, i + iii * Parallel);
+	}
+	
+	any = 0 ;
+	for (i = 0; i < rr; i++)
+		any |= bb[i] ;
+	return any ;
+}
+
+static inline int stream_byte(const bch_ctx *ctx, const unsigned char *codeword, int pos) {
+/* Eight received bits starting at bit pos (which divides 4) of the stream,
+ * zero past the end of the codeword
+ */
+	if (pos % 8 == 0)
+		return codeword[pos >> 3];
+	if ((pos >> 3) + 1 >= (ctx->nn_shorten + 7) / 8)
+		return (codeword[pos >> 3] << 4) & 0xff;
+	return ((codeword[pos >> 3] << 4) | (codeword[(pos >> 3) + 1] >> 4)) & 0xff;
+}
+
+static int packed_syndrome(const bch_ctx *ctx, bch_work *w, unsigned char *codeword) {
+/* Table driven computation of the syndrome polynomial on the packed stream.
+ * S(x) = r(x) mod g(x) = [ x**rr d(x) mod g(x) ] + b(x), so the received data
+ * is run through the same slicing-by-8 tables as the encoder and the received
+ * parity is added into the register.  Returns 0, leaving w->bb unset, if
+ * S(x) is zero.
+ */
+	uint64_t rem[rem_words_max] ;
+	int i, nb, last ;
+	int rr = ctx->rr, kk_shorten = ctx->kk_shorten ;
+	
+	// A trailing half byte of data shares its byte with the parity
+	nb = kk_shorten / 8 ;
+	if (kk_shorten % 8) {
+		last = codeword[nb] ;
+		codeword[nb] &= 0xf0 ;
+		packed_remainder(ctx, codeword, nb + 1, rem) ;
+		codeword[nb] = last ;
+	}
+	else
+		packed_remainder(ctx, codeword, nb, rem) ;
+	
+	// Bits past the parity are not part of the codeword
+	for (i = 0; i < rr / 8; i++)
+		remainder_xor_byte(ctx, rem, i, stream_byte(ctx, codeword, kk_shorten + 8 * i)) ;
+	if (rr % 8)
+		remainder_xor_byte(ctx, rem, i, stream_byte(ctx, codeword, kk_shorten + 8 * i) & (0xff << (8 - rr % 8))) ;
+	
+	if (remainder_zero(rem, ctx->rem_words))
+		return 0 ;
+	for (i = 0; i < rr; i++)
+		w->bb[i] = (rem[(rr - 1 - i) >> 6] >> ((rr - 1 - i) & 63)) & 1 ;
+	return 1 ;
+}
+
+static inline int gf_mul_alpha(const bch_ctx *ctx, int x, int e) {
+/* x * alpha**e, x in polynomial form and 0 <= e < nn */
+	if (x == 0)
+		return 0 ;
+	e += ctx->index_of[x] ;
+	if (e >= ctx->nn)
+		e -= ctx->nn ;
+	return ctx->alpha_to[e] ;
+}
+
+void gen_kernel_consts(bch_ctx *ctx) {
+/* Constants for the vector syndrome and Chien kernels */
+	int h, n, j ;
+	int nn = ctx->nn, *alpha_to = ctx->alpha_to ;
+	
+	for (h = 0; h < ctx->tt; h++)
+		for (n = 0; n < 6; n++)
+			gf_prepare_const(ctx, &ctx->syn_k[h][n], alpha_to[((2 * h + 1) * (gf_lanes >> n)) % nn]) ;
+	for (j = 1; j <= ctx->tt; j++)
+		gf_prepare_const(ctx, &ctx->chien_k[j], alpha_to[(j * gf_lanes) % nn]) ;
+}
+
+static void vector_syndromes(const bch_ctx *ctx, bch_work *w) {
+/* Odd syndromes based on S(x) with the vector kernel.  Lane l of step q holds
+ * bit 32q + l of S(x), so each syndrome is a Horner's rule in alpha**(32i)
+ * over the steps, after which the 32 lanes are folded in half five times
+ * with alpha**(16i), ..., alpha**i.
+ */
+	gf_planes acc, tmp ;
+	int h, j, n, f, nq ;
+	int rr = ctx->rr ;
+	const gf_kernel *gf = ctx->gf ;
+	
+	nq = (rr + gf_lanes - 1) / gf_lanes ;
+	memset(w->syn_in, 0, nq * sizeof(gf_planes)) ;
+	for (j = 0; j < rr; j++)
+		w->syn_in[j / gf_lanes].lo[j % gf_lanes] = w->bb[j] ;
+	
+	for (h = 0; h < ctx->tt; h++) {
+		memset(&acc, 0, sizeof(acc)) ;
+		gf->horner(&acc, &ctx->syn_k[h][0], w->syn_in, nq) ;
+		for (f = gf_lanes / 2, n = 1; f >= 1; f /= 2, n++) {
+			memset(&tmp, 0, sizeof(tmp)) ;
+			memcpy(tmp.lo, acc.lo + f, f) ;
+			memcpy(tmp.hi, acc.hi + f, f) ;
+			gf->mulc(&tmp, &ctx->syn_k[h][n]) ;
+			for (j = 0; j < f; j++) {
+				acc.lo[j] ^= tmp.lo[j] ;
+				acc.hi[j] ^= tmp.hi[j] ;
+			}
+		}
+		w->s[2 * h + 1] = gf_get_lane(&acc, 0) ;
+	}
+}
+
+static int scalar_chien(const bch_ctx *ctx, bch_work *w, int deg, const int *elp) {
+/* Chien search over the positions of the shortened code only, alpha**i for
+ * i = nn - nn_shorten + 1 .. nn, Parallel positions per step.  Stops as soon
+ * as deg roots are found or too few positions are left to find them.
+ * Ref: L&C pp.216, Fig.6.1
+ */
+	int reg[tt_max + 1];		// Index form of term j at the first position of the step
+	int off[tt_max + 1][parallel_max], adv[tt_max + 1], elp_sum[parallel_max] ;
+	int i, j, p, e, first, step, count ;
+	int nn = ctx->nn, *alpha_to = ctx->alpha_to, *index_of = ctx->index_of ;
+	
+	first = nn - ctx->nn_shorten + 1 ;
+	step = ctx->Parallel < parallel_max ? ctx->Parallel : parallel_max ;
+	for (j = 1; j <= deg; j++) {
+		reg[j] = elp[j] != 0 ? (index_of[elp[j]] + j * first) % nn : -1 ;
+		for (p = 0; p < step; p++)
+			off[j][p] = (j * p) % nn ;
+		adv[j] = (j * step) % nn ;
+	}
+	
+	count = 0 ;
+	for (i = first; i <= nn && nn - i + 1 >= deg - count; i += step) {
+		for (p = 0; p < step; p++)
+			elp_sum[p] = 1 ;
+		for (j = 1; j <= deg; j++) {
+			if (reg[j] == -1)
+				continue ;
+			for (p = 0; p < step; p++) {
+				e = reg[j] + off[j][p] ;
+				if (e >= nn)
+					e -= nn ;
+				elp_sum[p] ^= alpha_to[e] ;
+			}
+			reg[j] += adv[j] ;
+			if (reg[j] >= nn)
+				reg[j] -= nn ;
+		}
+		
+		// store root and error location number indices
+		for (p = 0; p < step && i + p <= nn; p++)
+			if (elp_sum[p] == 0) {
+				w->location[count] = nn - (i + p) ;
+				if (ctx->Verbose) fprintf(stdout,"count: %d location: %d L[ttx2-1] %d\n",
+						count,w->location[count],deg);
+				if (++count == deg) {
+					i += step ;
+					break ;
+				}
+			}
+		if (count == deg)
+			break ;
+	}
+	w->chien_points = (i <= nn ? i : nn + 1) - first ;
+	return count ;
+}
+
+static int vector_chien(const bch_ctx *ctx, bch_work *w, int deg, const int *elp) {
+/* Chien search with the vector kernel, 32 positions per step, over the same
+ * range and with the same early exits as scalar_chien().
+ */
+	uint32_t found ;
+	int i, j, l, first, count ;
+	int nn = ctx->nn ;
+	
+	first = nn - ctx->nn_shorten + 1 ;
+	for (j = 1; j <= deg; j++)
+		for (l = 0; l < gf_lanes; l++)
+			gf_set_lane(&w->chien_term[j], l, gf_mul_alpha(ctx, elp[j], (j * (first + l)) % nn)) ;
+	
+	count = 0 ;
+	for (i = first; i <= nn && nn - i + 1 >= deg - count; i += gf_lanes) {
+		found = ctx->gf->chien(w->chien_term, ctx->chien_k, deg) ;
+		while (found) {
+			l = __builtin_ctz(found) ;
+			found &= found - 1 ;
+			if (i + l > nn)
+				break ;
+			w->location[count] = nn - (i + l) ;
+			if (ctx->Verbose) fprintf(stdout,"count: %d location: %d L[ttx2-1] %d\n",
+					count,w->location[count],deg);
+			if (++count == deg) {
+				w->chien_points = (i + gf_lanes <= nn ? i + gf_lanes : nn + 1) - first ;
+				return count ;
+			}
+		}
+	}
+	w->chien_points = (i <= nn ? i : nn + 1) - first ;
+	return count ;
+}
+
+static void remainder_syndromes(const bch_ctx *ctx, bch_work *w) {
+/* Odd syndromes based on S(x), a byte of it per step by Horner's rule with
+ * the tables of direct_syndrome():  S = S * alpha**(8i) + T_i[byte]
+ */
+	int h, i, j, q, nq, step ;
+	int nn = ctx->nn, rr = ctx->rr ;
+	int *bb = w->bb ;
+	int (*syn_table)[256] = ctx->syn_table ;
+	unsigned char bytes[(rr_max + 7) / 8] ;
+	
+	// Bit j of S(x) is bit 7 - j % 8 of byte j / 8
+	nq = (rr + 7) / 8 ;
+	memset(bytes, 0, nq) ;
+	for (j = 0; j < rr; j++)
+		bytes[j >> 3] |= bb[j] << (7 - (j & 7)) ;
+	
+	for (h = 0; h < ctx->tt; h++) {
+		i = 2 * h + 1 ;
+		step = (8 * i) % nn ;
+		w->s[i] = syn_table[h][bytes[nq - 1]] ;
+		for (q = nq - 2; q >= 0; q--)
+			w->s[i] = gf_mul_alpha(ctx, w->s[i], step) ^ syn_table[h][bytes[q]] ;
+	}
+}
+
+void gen_syndrome_tables(bch_ctx *ctx) {
+/* syn_table[h][v] is the contribution of byte v to S(2h+1) at the lowest
+ * order position: the sum of alpha**((2h+1)*j) over the set bits j of v,
+ * where the MSB is j = 0.
+ */
+	int h, v, j ;
+	
+	for (h = 0; h < ctx->tt; h++)
+		for (v = 0; v < 256; v++) {
+			ctx->syn_table[h][v] = 0 ;
+			for (j = 0; j < 8; j++)
+				if (v & (0x80 >> j))
+					ctx->syn_table[h][v] ^= ctx->alpha_to[((2 * h + 1) * j) % ctx->nn] ;
+		}
+}
+
+
+static void direct_syndrome(const bch_ctx *ctx, bch_work *w, const unsigned char *codeword) {
+/* Evaluate the odd syndromes S(i) = r(alpha**i) straight from the packed
+ * stream, by Horner's rule one byte at a time:  S = S * alpha**(8i) + T_i[byte]
+ * r(x) = x**rr d(x) + b(x), so the data and parity are run separately and
+ * the data sum is raised by alpha**(i*rr).
+ */
+	int h, i, n, step, ds, ps, nb_data, nb_parity, last_data, last_parity ;
+	int nn = ctx->nn, rr = ctx->rr, kk_shorten = ctx->kk_shorten ;
+	int (*syn_table)[256] = ctx->syn_table ;
+	
+	nb_data = (kk_shorten + 7) / 8 ;
+	nb_parity = (rr + 7) / 8 ;
+	last_data = codeword[nb_data - 1] & (0xff << ((8 - kk_shorten % 8) % 8)) ;
+	last_parity = stream_byte(ctx, codeword, kk_shorten + 8 * (nb_parity - 1)) & (0xff << ((8 - rr % 8) % 8)) ;
+	
+	for (h = 0; h < ctx->tt; h++) {
+		i = 2 * h + 1 ;
+		step = (8 * i) % nn ;
+		
+		ds = syn_table[h][last_data] ;
+		for (n = nb_data - 2; n >= 0; n--)
+			ds = gf_mul_alpha(ctx, ds, step) ^ syn_table[h][codeword[n]] ;
+		
+		ps = syn_table[h][last_parity] ;
+		for (n = nb_parity - 2; n >= 0; n--)
+			ps = gf_mul_alpha(ctx, ps, step) ^ syn_table[h][stream_byte(ctx, codeword, kk_shorten + 8 * n)] ;
+		
+		w->s[i] = gf_mul_alpha(ctx, ds, (i * rr) % nn) ^ ps ;
+	}
+}
+
+static void expand_syndromes(const bch_ctx *ctx, bch_work *w) {
+/* Computation 2t syndromes from the odd syndromes */
+	int i, j ;
+	int nn = ctx->nn, ttx2 = 2 * ctx->tt, *alpha_to = ctx->alpha_to, *index_of = ctx->index_of ;
+	int *s = w->s, syn_error ;
+	
+	syn_error = 0 ;
+	for (i = 1; i <= ttx2 - 1; i = i+2)
+		if (s[i] != 0)
+			syn_error = 1 ;	// set flag if non-zero syndrome => error
+
+	// Even syndrome = (Odd syndrome) ** 2
+	for (i = 2; i <= ttx2; i = i + 2) {
+	 	j = i / 2;
+		if (s[j] == 0)
+			s[i] = 0;
+		else
+			s[i] =  alpha_to[(2 * index_of[s[j]]) % nn];
+	}
+	
+	w->syn_error = syn_error ;
+	
+	if (ctx->Verbose) {
+		fprintf(stdout, "# The syndrome from parallel decoder is:\n") ;
+		for (i = 1; i <= ttx2; i++)
+			fprintf(stdout, "   %4d (%4d) == 0x%04x (0x%x)\n", s[i],index_of[s[i]],s[i], index_of[s[i]]) ;
+		fprintf(stdout, "\n\n") ;
+	}
+}
+
+static inline int gf_mul(const bch_ctx *ctx, int a, int b) {
+	int e ;
+	
+	if (a == 0 || b == 0)
+		return 0 ;
+	e = ctx->index_of[a] + ctx->index_of[b] ;
+	if (e >= ctx->nn)
+		e -= ctx->nn ;
+	return ctx->alpha_to[e] ;
+}
+
+static inline int gf_div(const bch_ctx *ctx, int a, int b) {
+	int e ;
+	
+	if (a == 0)
+		return 0 ;
+	e = ctx->index_of[a] - ctx->index_of[b] ;
+	if (e < 0)
+		e += ctx->nn ;
+	return ctx->alpha_to[e] ;
+}
+
+static inline int gf_pow(const bch_ctx *ctx, int a, int n) {
+	if (a == 0)
+		return 0 ;
+	return ctx->alpha_to[(int)(((long)ctx->index_of[a] * n) % ctx->nn)] ;
+}
+
+static inline int gf_sqrt(const bch_ctx *ctx, int a) {
+	int e ;
+	
+	if (a == 0)
+		return 0 ;
+	e = ctx->index_of[a] ;
+	return ctx->alpha_to[(e & 1) ? (e + ctx->nn) / 2 : e / 2] ;
+}
+
+void gen_quadratic_table(bch_ctx *ctx) {
+/* Roots of y**2 + y = c for every c with trace zero */
+	int y ;
+	
+	for (y = 0; y <= ctx->nn; y++)
+		ctx->quad_table[y] = -1 ;
+	for (y = 0; y <= ctx->nn; y++)
+		ctx->quad_table[gf_mul(ctx, y, y) ^ y] = y ;
+}
+
+static int gf_linear_solve(const bch_ctx *ctx, const int *col, int c, int *sol) {
+/* All y = sum of alpha**b over the set bits b with col[b] summed to c, for
+ * col[b] the image of alpha**b under a GF(2)-linear map.  Gaussian
+ * elimination over mm equations; returns the number of solutions, or -1 if
+ * there are more than 4.
+ */
+	int row[mm_max], pivot[mm_max], free_var[mm_max] ;
+	int r, b, i, n, nfree, nrow, y, v ;
+	int mm = ctx->mm ;
+	
+	for (r = 0; r < mm; r++) {
+		row[r] = ((c >> r) & 1) << mm ;
+		for (b = 0; b < mm; b++)
+			row[r] |= ((col[b] >> r) & 1) << b ;
+	}
+	
+	nrow = 0 ;
+	nfree = 0 ;
+	for (b = 0; b < mm; b++) {
+		for (r = nrow; r < mm && !((row[r] >> b) & 1); r++)
+			;
+		if (r == mm) {
+			free_var[nfree++] = b ;
+			continue ;
+		}
+		v = row[r] ; row[r] = row[nrow] ; row[nrow] = v ;
+		for (r = 0; r < mm; r++)
+			if (r != nrow && ((row[r] >> b) & 1))
+				row[r] ^= row[nrow] ;
+		pivot[nrow++] = b ;
+	}
+	for (r = nrow; r < mm; r++)
+		if (row[r] >> mm)
+			return 0 ;
+	if (nfree > 2)
+		return -1 ;
+	
+	// Particular solution plus every combination of the kernel basis
+	for (n = 0; n < (1 << nfree); n++) {
+		y = 0 ;
+		for (i = 0; i < nfree; i++)
+			if ((n >> i) & 1)
+				y |= 1 << free_var[i] ;
+		for (r = 0; r < nrow; r++) {
+			v = row[r] >> mm ;
+			for (i = 0; i < nfree; i++)
+				if ((n >> i) & 1)
+					v ^= (row[r] >> free_var[i]) & 1 ;
+			if (v)
+				y |= 1 << pivot[r] ;
+		}
+		sol[n] = y ;
+	}
+	return 1 << nfree ;
+}
+
+static int affine_roots(const bch_ctx *ctx, int p, int q, int c, int *root) {
+/* Roots of the affine polynomial y**4 + p y**2 + q y = c */
+	int col[mm_max], b, y ;
+	
+	for (b = 0; b < ctx->mm; b++) {
+		y = ctx->alpha_to[b] ;
+		col[b] = gf_pow(ctx, y, 4) ^ gf_mul(ctx, p, gf_mul(ctx, y, y)) ^ gf_mul(ctx, q, y) ;
+	}
+	return gf_linear_solve(ctx, col, c, root) ;
+}
+
+static int closed_form_roots(const bch_ctx *ctx, int deg, const int *elp, int *X) {
+/* Roots of the reversed ELP, z**deg + elp[1] z**(deg-1) + ... + elp[deg],
+ * which are the error locators X directly, for deg <= 4 without a Chien
+ * search.  Returns the number of distinct roots found.
+ * Ref: Berlekamp, Rumsey & Solomon, On the solution of algebraic equations
+ *      over finite fields, 1967
+ */
+	int a, b, c, d, e, k, p, q, y[4], n, i ;
+	const int *quad_table = ctx->quad_table ;
+	
+	a = elp[1] ;
+	switch (deg) {
+	case 1:
+		X[0] = a ;
+		return 1 ;
+	case 2:
+		// z = a y:  y**2 + y = b / a**2
+		if (a == 0 || quad_table[gf_div(ctx, elp[2], gf_mul(ctx, a, a))] < 0)
+			return 0 ;
+		X[0] = gf_mul(ctx, a, quad_table[gf_div(ctx, elp[2], gf_mul(ctx, a, a))]) ;
+		X[1] = X[0] ^ a ;
+		return 2 ;
+	case 3:
+		// z = y + a:  y**3 + p y + q, with p = a**2 + b, q = ab + c.
+		// Its roots are the non-zero roots of y**4 + p y**2 + q y.
+		b = elp[2] ;
+		c = elp[3] ;
+		p = gf_mul(ctx, a, a) ^ b ;
+		q = gf_mul(ctx, a, b) ^ c ;
+		if (q == 0 || affine_roots(ctx, p, q, 0, y) != 4)
+			return 0 ;
+		for (i = 0, n = 0; i < 4; i++)
+			if (y[i] != 0)
+				X[n++] = y[i] ^ a ;
+		return n ;
+	case 4:
+		b = elp[2] ;
+		c = elp[3] ;
+		d = elp[4] ;
+		if (a == 0) {
+			n = affine_roots(ctx, b, c, d, X) ;
+			return n < 0 ? 0 : n ;
+		}
+		// z = y + e with e**2 = c / a removes the linear term:
+		// y**4 + a y**3 + (ae + b) y**2 + k,  k = z(e).  With w = 1/y:
+		// w**4 + ((ae + b) / k) w**2 + (a / k) w = 1 / k
+		e = gf_sqrt(ctx, gf_div(ctx, c, a)) ;
+		k = gf_pow(ctx, e, 4) ^ gf_mul(ctx, a, gf_pow(ctx, e, 3)) ^ gf_mul(ctx, b, gf_mul(ctx, e, e)) ^ gf_mul(ctx, c, e) ^ d ;
+		if (k == 0)
+			return 0 ;
+		n = affine_roots(ctx, gf_div(ctx, gf_mul(ctx, a, e) ^ b, k), gf_div(ctx, a, k), gf_div(ctx, 1, k), y) ;
+		if (n < 0)
+			return 0 ;
+		for (i = 0; i < n; i++)
+			X[i] = gf_div(ctx, 1, y[i]) ^ e ;
+		return n ;
+	}
+	return 0 ;
+}
+
+static int store_locators(const bch_ctx *ctx, bch_work *w, int n, const int *X) {
+/* Convert error locators to locations in the order of the Chien search
+ * (descending).  Returns the count, or -1 if a locator is repeated, zero or
+ * outside the shortened code.
+ */
+	int i, j, v ;
+	int *index_of = ctx->index_of, *location = w->location ;
+	
+	for (i = 0; i < n; i++) {
+		if (X[i] == 0 || index_of[X[i]] >= ctx->nn_shorten)
+			return -1 ;
+		v = index_of[X[i]] ;
+		for (j = i; j > 0 && location[j - 1] < v; j--)
+			location[j] = location[j - 1] ;
+		if (j > 0 && location[j - 1] == v)
+			return -1 ;
+		location[j] = v ;
+	}
+	return n ;
+}
+
+static int low_weight_decode(const bch_ctx *ctx, bch_work *w) {
+/* Decode one or two errors straight from the odd syndromes, before the
+ * Berlekamp-Massey loop.  The pattern is accepted only if it reproduces every
+ * odd syndrome, which by the minimum distance makes it the one BM would find.
+ * Returns the number of errors located, or 0 to fall back to BM.
+ */
+	int X[2], n, i, j, v ;
+	int tt = ctx->tt, ttx2 = 2 * ctx->tt, *s = w->s ;
+	
+	if (s[1] == 0)
+		return 0 ;
+	X[0] = s[1] ;
+	n = 1 ;
+	// Single error:  S(i) = X**i.  Double errors:  X1 + X2 = S1 and
+	// X1 X2 = (S3 + S1**3) / S1, solved as a quadratic
+	if (tt > 1 && (v = s[3] ^ gf_pow(ctx, s[1], 3)) != 0) {
+		if (closed_form_roots(ctx, 2, (int []){ 1, s[1], gf_div(ctx, v, s[1]) }, X) != 2)
+			return 0 ;
+		n = 2 ;
+	}
+	for (i = 1; i <= ttx2 - 1; i += 2) {
+		v = 0 ;
+		for (j = 0; j < n; j++)
+			v ^= gf_pow(ctx, X[j], i) ;
+		if (v != s[i])
+			return 0 ;
+	}
+	n = store_locators(ctx, w, n, X) ;
+	if (ctx->Verbose && n > 0) fprintf(stdout,"Low weight decode:  %d errors\n", n);
+	return n > 0 ? n : 0 ;
+}
+
+static void storage_locations(const bch_ctx *ctx, bch_work *w) {
+/* Convert the error locations from systematic form to storage form */
+	int i ;
+	
+	for (i = 0; i < w->count; i++)
+		w->location[i] = w->location[i] >= ctx->rr ? w->location[i] - ctx->rr : w->location[i] + ctx->kk_shorten ;
+}
+
+static void correct_errors(const bch_ctx *ctx, bch_work *w, unsigned char *codeword) {
+/* Correct errors by flipping the error bits, converting the error locations
+ * from systematic form to storage form
+ */
+	int i, j ;
+	
+	storage_locations(ctx, w) ;
+	for (i = 0; i < w->count; i++) {
+		j = w->location[i] ;
+	 	codeword[j >> 3] ^= 0x80 >> (j & 7) ;
+	}
+}
+
+static int inversionless_bm(const bch_ctx *ctx, bch_work *w, int *elp) {
+/* Simplified inversionless Berlekamp-Massey for binary BCH codes.  Exactly t
+ * iterations, one per odd syndrome, on two rolling polynomials held in
+ * polynomial form:  the ELP lambda(x) and the correction term c(x), which is
+ * x times the B(x) of the references.  Per iteration
+ *	lambda(x) = gamma lambda(x) + delta c(x)
+ *	c(x)      = x**2 lambda_old(x), gamma = delta	if delta != 0 and k >= 0
+ *	c(x)      = x**2 c(x)				otherwise
+ * with k = 2r - 2L tracking the register length L.  lambda(x) is a scaled
+ * ELP; it is made monic once at the end.  Returns the degree L of the ELP,
+ * or tt + 1 if there are more than t errors.
+ * Ref: Sarwate & Shanbhag, High-speed architectures for Reed-Solomon
+ *      decoders, IEEE Trans. VLSI Systems, 2001
+ */
+	int lambda[tt_max + 2], c[tt_max + 2] ;
+	int delta, gamma, k, r, i, v, top, swap ;
+	int tt = ctx->tt, *s = w->s ;
+	
+	for (i = 0; i <= tt + 1; i++) {
+		lambda[i] = 0 ;
+		c[i] = 0 ;
+	}
+	lambda[0] = 1 ;
+	c[1] = 1 ;
+	gamma = 1 ;
+	k = 0 ;
+	
+	for (r = 0; r < tt; r++) {
+		// Discrepancy of the odd step 2r + 1
+		top = 2 * r < tt + 1 ? 2 * r : tt + 1 ;
+		delta = 0 ;
+		for (i = 0; i <= top; i++)
+			delta ^= gf_mul(ctx, lambda[i], s[2 * r + 1 - i]) ;
+		
+		swap = delta != 0 && k >= 0 ;
+		for (i = tt + 1; i >= 0; i--) {
+			v = i < 2 ? 0 : (swap ? lambda[i - 2] : c[i - 2]) ;
+			lambda[i] = gf_mul(ctx, gamma, lambda[i]) ^ gf_mul(ctx, delta, c[i]) ;
+			c[i] = v ;
+		}
+		if (swap) {
+			gamma = delta ;
+			k = -k ;
+		}
+		else
+			k += 2 ;
+		
+		if (ctx->Verbose) {
+			fprintf(stdout,"Loop %d:\n     delta = %x, L = %d, lambda:", 2 * r + 1, delta, r + 1 - k / 2) ;
+			for (i = 0; i <= tt + 1; i++)
+				fprintf(stdout,"  0x%x", lambda[i]) ;
+			fprintf(stdout,"\n") ;
+		}
+	}
+	
+	// After 2t steps k = 2t - 2L
+	w->bm_iterations = tt ;
+	if (k < 0)
+		return tt + 1 ;
+	for (i = 0; i <= tt - k / 2; i++)
+		elp[i] = gf_div(ctx, lambda[i], lambda[0]) ;
+	return tt - k / 2 ;
+}
+
+int bch_syndromes(const bch_ctx *ctx, bch_work *w, unsigned char *codeword) {
+/* The 2t syndromes of a codeword into w->s.  Returns w->syn_error, 0 if the
+ * codeword has no errors.
+ */
+	int dirty ;
+	
+	if (ctx->flags & BCH_DIRECT)
+		direct_syndrome(ctx, w, codeword) ;
+	else {
+		if (ctx->flags & BCH_LOOKAHEAD)
+			dirty = parallel_syndrome(ctx, w, codeword) ;
+		else if (ctx->fixed)
+			dirty = ctx->fixed->syndrome(ctx, w, codeword) ;
+		else
+			dirty = packed_syndrome(ctx, w, codeword) ;
+		
+		// A codeword is clean iff S(x) is zero:  skip the field arithmetic
+		if (!dirty) {
+			if (!ctx->Verbose) {
+				memset(w->s, 0, (2 * ctx->tt + 1) * sizeof(int)) ;
+				w->syn_error = 0 ;
+				return 0 ;
+			}
+			memset(w->bb, 0, ctx->rr * sizeof(int)) ;
+		}
+		if (ctx->gf)
+			vector_syndromes(ctx, w) ;
+		else if (ctx->fixed)
+			ctx->fixed->odd_syndromes(ctx, w) ;
+		else
+			remainder_syndromes(ctx, w) ;
+	}
+	expand_syndromes(ctx, w) ;
+	return w->syn_error ;
+}
+
+int bch_key_equation(const bch_ctx *ctx, bch_work *w, int *sigma) {
+/* Solve the key equation for the ELP sigma(x), in polynomial form, from the
+ * 2t syndromes in w->s.  Returns its degree, or tt + 1 if there are more than
+ * t errors.  The Berlekamp-Massey loop leaves w->s in index form.
+ */
+	int ttx2 = 2 * ctx->tt, tt = ctx->tt, nn = ctx->nn, Verbose = ctx->Verbose ;
+	int *alpha_to = ctx->alpha_to, *index_of = ctx->index_of, *s = w->s ;
+	register int i ;
+	// Of the table of L&C only three rows are live:  step u, step u + 2
+	// and step q, the earlier step with a discrepancy and the greatest
+	// u - L, the most recent on a tie.  Each is an ELP (polynomial form),
+	// its degree L, u_L and discrepancy (index form).
+	int rows = ttx2 + 4 ;
+	int elp_a[rows], elp_b[rows], elp_q[rows] ;
+	int *elp_u, *elp_n, *swap ;	// ELP of step u, step u + 2
+	int L_u, L_n, L_q ;		// Degree of ELP 
+	int u_L_u, u_L_n, u_L_q ;	// Difference between step number and the degree of ELP
+	int desc_u, desc_n, desc_q ;	// 'mu'th discrepancy
+	int u;				// u = 'mu' + 1 and u ranges from -1 to 2*t (see L&C)
+	int q;				// Step of row q
+	int deg;			// Degree of the final ELP
+
+	// Simplified Berlekamp-Massey Algorithm for Binary BCH codes
+	// 	Ref: Blahut, pp.191, Chapter 7.6 
+	// 	Ref: L&C, pp.212, Chapter 6.4
+	//
+	// Following the terminology of Lin and Costello's book:   
+	// 	desc[u] is the 'mu'th discrepancy, where  
+	// 	u='mu'+1 and 
+	// 	'mu' (the Greek letter!) is the step number ranging 
+	// 		from -1 to 2*t (see L&C)
+	// 	l[u] is the degree of the elp at that step, and 
+	// 	u_L[u] is the difference between the step number 
+	// 		and the degree of the elp. 
+	
+	if (ctx->flags & BCH_INVERSIONLESS) {
+		if (Verbose) fprintf(stdout,"Beginning inversionless Berlekamp loop\n");
+		deg = inversionless_bm(ctx, w, sigma) ;
+		if (Verbose) fprintf(stdout,"\n");
+	}
+	else {
+		if (Verbose) fprintf(stdout,"Beginning Berlekamp loop\n");
+
+		// initialise table entries
+		for (i = 1; i <= ttx2; i++) 
+			s[i] = index_of[s[i]];
+
+		// Row 0 ('mu' = -1) is row q to start with, row 1 ('mu' = 0) is
+		// the first row u
+		elp_u = elp_a ;
+		elp_n = elp_b ;
+		for (i = 0; i < rows; i++) {
+			elp_q[i] = 0;			/* polynomial form */
+			elp_u[i] = 0;			/* polynomial form */
+		}
+		elp_q[0] = 1;
+		elp_u[0] = 1;
+		desc_q = 0;				/* index form */
+		desc_u = s[1];				/* index form */
+		L_q = 0;
+		L_u = 0;
+		u_L_q = -1;
+		u_L_u = 0;
+		q = 0;
+		u = -1; 
+ 
+		do {
+			// even loops always produce no discrepany so they can be skipped
+			u = u + 2; 
+			if (Verbose) fprintf(stdout,"Loop %d:\n", u);
+			if (Verbose) fprintf(stdout,"     desc[%d] = %x\n", u, desc_u);
+			if (desc_u == -1) {
+				L_n = L_u;
+				for (i = 0; i <= L_u; i++)
+					elp_n[i] = elp_u[i]; 
+			}
+			else {
+				// store degree of new elp polynomial
+				if (L_u > L_q + u - q)
+					L_n = L_u;
+				else
+					L_n = L_q + u - q;
+ 
+				// Form new elp(x)
+				for (i = 0; i < rows; i++) 
+					elp_n[i] = 0;
+				for (i = 0; i <= L_q; i++) 
+					if (elp_q[i] != 0)
+						elp_n[i + u - q] = alpha_to[(desc_u + nn - desc_q + index_of[elp_q[i]]) % nn];
+				for (i = 0; i <= L_u; i++) 
+					elp_n[i] ^= elp_u[i];
+
+			}
+			u_L_n = u+1 - L_n;
+ 
+			// Form (u+2)th discrepancy, needed by the next loop only
+			desc_n = -1 ;
+			if (u + 2 < ttx2) {	
+				if (s[u + 2] != -1)
+					desc_n = alpha_to[s[u + 2]];
+				else 
+					desc_n = 0;
+
+				for (i = 1; i <= L_n; i++) 
+					if ((s[u + 2 - i] != -1) && (elp_n[i] != 0))
+			        		desc_n ^= alpha_to[(s[u + 2 - i] + index_of[elp_n[i]]) % nn];
+			 	// put desc[u+2] into index form 
+				desc_n = index_of[desc_n];	
+
+			}
+
+			if (Verbose) {
+				fprintf(stdout,"     deg(elp) = %2d --> elp(%2d):", L_u, u);
+				for (i=0; i<=L_u; i++)
+					fprintf(stdout,"  0x%x", elp_u[i]);
+				fprintf(stdout,"\n");
+				fprintf(stdout,"     deg(elp) = %2d --> elp(%2d):", L_n, u+2);
+				for (i=0; i<=L_n; i++)
+					fprintf(stdout,"  0x%x", elp_n[i]);
+				fprintf(stdout,"\n");
+				fprintf(stdout,"     u_L[%2d] = %2d\n", u, u_L_u);
+				fprintf(stdout,"     u_L[%2d] = %2d\n", u+2, u_L_n);
+			}
+
+			// Step u becomes a candidate for row q:  it has a
+			// discrepancy and u_L at least that of row q
+			if (desc_u != -1 && u_L_u >= u_L_q) {
+				memcpy(elp_q, elp_u, rows * sizeof(int)) ;
+				L_q = L_u ;
+				u_L_q = u_L_u ;
+				desc_q = desc_u ;
+				q = u ;
+			}
+			swap = elp_u ;
+			elp_u = elp_n ;
+			elp_n = swap ;
+			L_u = L_n ;
+			u_L_u = u_L_n ;
+			desc_u = desc_n ;
+
+		} while ((u < (ttx2-1)) && (L_u <= tt)); 
+		if (Verbose) fprintf(stdout,"\n");
+		u=u+2;
+		w->bm_iterations = (u - 1) / 2 ;
+		deg = L_u ;
+		for (i = 0; i <= deg && deg <= tt; i++)
+			sigma[i] = elp_u[i] ;
+	}
+	return deg ;
+}
+
+int bch_roots(const bch_ctx *ctx, bch_work *w, int deg, const int *sigma) {
+/* Roots of the ELP sigma(x) of degree deg:  closed form up to degree 4,
+ * Chien search above.  Their systematic form positions are left in
+ * w->location.  Returns the number found, which is deg only if the
+ * codeword can be corrected.
+ */
+	int ttx2 = 2 * ctx->tt, Verbose = ctx->Verbose ;
+	int *index_of = ctx->index_of ;
+	int i, n ;
+	int X[4];			// Error locators from the closed form root finding
+
+	// Chien's search to find roots of the error location polynomial
+	// Ref: L&C pp.216, Fig.6.1
+	if (Verbose) fprintf(stdout,"Chien Search:  L[%d]=%d=%x\n", ttx2-1,deg,deg);
+	if (Verbose) fprintf(stdout,"Sigma(x) = \n");
+
+	if (Verbose) 
+		for (i = 0; i <= deg; i++) 
+			if (sigma[i] != 0)
+				fprintf(stdout,"    %4d (%4d)\n", sigma[i], index_of[sigma[i]]);
+			else
+				fprintf(stdout,"     0\n");
+
+	if (Verbose)
+		for (i = 1; i <= deg; i++)
+			fprintf(stdout,"  reg[%d]=%d=%x\n", i,index_of[sigma[i]],index_of[sigma[i]]);
+	
+	w->chien_points = 0 ;
+	if (deg <= 4) {
+		n = closed_form_roots(ctx, deg, sigma, X) ;
+		n = store_locators(ctx, w, n, X) ;
+	}
+	else if (ctx->gf)
+		n = vector_chien(ctx, w, deg, sigma) ;
+	else
+		n = scalar_chien(ctx, w, deg, sigma) ;
+	return n ;
+}
+
+static inline void stat_lap(bch_stats *stats, int stage, int timed, uint64_t *lap) {
+/* Count a codeword reaching stage; if it is timed, charge the time since *lap
+ * to stage and start the next one
+ */
+	uint64_t now ;
+	
+	stats->calls[stage]++ ;
+	if (timed) {
+		now = bch_cycles() ;
+		stats->cycles[stage] += now - *lap ;
+		stats->timed[stage]++ ;
+		*lap = now ;
+	}
+}
+
+static int locate_errors(const bch_ctx *ctx, bch_work *w, bch_stats *stats, int timed, uint64_t *lap) {
+/* Locate the errors of the 2t non-zero syndromes in w->s:  closed form for
+ * one or two, else the key equation and its roots.  Leaves w->count
+ * locations, systematic form, in w->location.  Returns 0 if the codeword is
+ * unable to decode.
+ */
+	int tt = ctx->tt ;
+	int sigma[tt_max + 2];		// Final ELP of either key equation solver
+	int deg;			// Its degree
+	
+	if ((w->count = low_weight_decode(ctx, w)) > 0) {
+		if (stats)
+			stat_lap(stats, stat_low_weight, timed, lap) ;
+		return 1 ;
+	}
+	if (stats)
+		stat_lap(stats, stat_low_weight, timed, lap) ;
+	// Having errors, begin decoding procedure
+	deg = bch_key_equation(ctx, w, sigma) ;
+	if (stats) {
+		stat_lap(stats, stat_key_equation, timed, lap) ;
+		stats->bm_iterations += w->bm_iterations ;
+	}
+	if (deg > tt) 
+		return 0 ;
+	w->count = bch_roots(ctx, w, deg, sigma) ;
+	if (stats) {
+		stat_lap(stats, stat_roots, timed, lap) ;
+		stats->chien_points += w->chien_points ;
+	}
+	// Number of roots = degree of elp hence <= tt errors, else > tt errors
+	// and cannot solve
+	return w->count == deg ;
+}
+
+int bch_locate(const bch_ctx *ctx, bch_work *w) {
+/* Locate the errors of the odd syndromes in w->s, the even ones being
+ * filled in, without touching a codeword.  Leaves their storage form
+ * positions in w->location.  Returns how many, or -1 if unable to decode.
+ */
+	expand_syndromes(ctx, w) ;
+	if (!w->syn_error)
+		return w->count = 0 ;
+	if (!locate_errors(ctx, w, NULL, 0, NULL))
+		return -1 ;
+	storage_locations(ctx, w) ;
+	return w->count ;
+}
+
+int bch_decode(const bch_ctx *ctx, bch_work *w, unsigned char *codeword) {
+/* Decode one codeword of nn_shorten packed bits, MSB first, data then
+ * parity.  Errors are corrected in place and their storage form positions
+ * left in w->location in the order of the Chien search.  Returns the number
+ * of errors, or -1 if the codeword is unable to decode.
+ */
+	int tt = ctx->tt ;
+	int decode_flag;		// Decoding indicator 
+	bch_stats *stats = ctx->flags & BCH_STATS ? &w->stats : NULL ;
+	uint64_t lap = 0 ;		// Start of the stage being timed
+	int timed ;			// Codeword sampled for timing
+
+	// The clock costs as much as a few percent of a clean decode, so only
+	// one codeword in stat_sample + 1 is timed
+	timed = stats && (stats->codewords & stat_sample) == 0 ;
+	if (timed)
+		lap = bch_cycles() ;
+	bch_syndromes(ctx, w, codeword) ;
+	if (stats)
+		stat_lap(stats, stat_syndrome, timed, &lap) ;
+	
+	if (!w->syn_error) {
+		decode_flag = 1 ;	// No errors
+		w->count = 0 ;
+	}
+	else if ((decode_flag = locate_errors(ctx, w, stats, timed, &lap)))
+		correct_errors(ctx, w, codeword) ;
+	if (stats) {
+		stats->codewords++ ;
+		stats->errors[decode_flag ? w->count : tt + 1]++ ;
+	}
+	return decode_flag ? w->count : -1 ;
+}
@@ -1,495 +1,735 @@
-/*******************************************************************************
-*
-*    File Name:  bch_decoder.c
-*     Revision:  2.0
-*         Date:  March, 2007
-*        Email:  nandsupport@micron.com
-*      Company:  Micron Technology, Inc.
-*
-*  Description:  Micron NAND BCH Decoder
-*
-*   References: 
-* 		  1. Error Control Coding, Lin & Costello, 2nd Ed., 2004
-* 		  2. Error Control Codes, Blahut, 1983
-**
-*   Disclaimer   This software code and all associated documentation, comments or other 
-*  of Warranty:  information (collectively "Software") is provided "AS IS" without 
-*                warranty of any kind. MICRON TECHNOLOGY, INC. ("MTI") EXPRESSLY 
-*                DISCLAIMS ALL WARRANTIES EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED 
-*                TO, NONINFRINGEMENT OF THIRD PARTY RIGHTS, AND ANY IMPLIED WARRANTIES 
-*                OF MERCHANTABILITY OR FITNESS FOR ANY PARTICULAR PURPOSE. MTI DOES NOT 
-*                WARRANT THAT THE SOFTWARE WILL MEET YOUR REQUIREMENTS, OR THAT THE 
-*                OPERATION OF THE SOFTWARE WILL BE UNINTERRUPTED OR ERROR-FREE. 
-*                FURTHERMORE, MTI DOES NOT MAKE ANY REPRESENTATIONS REGARDING THE USE OR 
-*                THE RESULTS OF THE USE OF THE SOFTWARE IN TERMS OF ITS CORRECTNESS, 
-*                ACCURACY, RELIABILITY, OR OTHERWISE. THE ENTIRE RISK ARISING OUT OF USE 
-*                OR PERFORMANCE OF THE SOFTWARE REMAINS WITH YOU. IN NO EVENT SHALL MTI, 
-*                ITS AFFILIATED COMPANIES OR THEIR SUPPLIERS BE LIABLE FOR ANY DIRECT, 
-*                INDIRECT, CONSEQUENTIAL, INCIDENTAL, OR SPECIAL DAMAGES (INCLUDING, 
-*                WITHOUT LIMITATION, DAMAGES FOR LOSS OF PROFITS, BUSINESS INTERRUPTION, 
-*                OR LOSS OF INFORMATION) ARISING OUT OF YOUR USE OF OR INABILITY TO USE 
-*                THE SOFTWARE, EVEN IF MTI HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH 
-*                DAMAGES. Because some jurisdictions prohibit the exclusion or 
-*                limitation of liability for consequential or incidental damages, the 
-*                above limitation may not apply to you.
-*
-*                Copyright 2007 Micron Technology, Inc. All rights reserved.
-*
-* Rev  Author			Date		Changes
-* ---  ---------------	----------	-------------------------------
-* 1.0  ZS		08/07/2006	Initial release
-* 2.0  PF		03/05/2007	Fixed bug that caused some codewords
-* 					to not be corrected
-* 
-* 
-/*******************************************************************************/
-
-#include "bch_global.c"
-
-int bb[rr_max] ;	// Syndrome polynomial
-int s[rr_max];		// Syndrome values
-int syn_error;		// Syndrome error indicator
-int count;		// Number of errors
-int location[tt_max];	// Error location
-int ttx2;		// 2t
-int decode_flag;	// Decoding indicator 
-	
-void parallel_syndrome() {
-/* Parallel computation of 2t syndromes.
- * Use the same lookahead matrix T_G_R of parallel computation of parity check bits.
- * The incoming streams are fed into registers from left hand
- */
-	int i, j, iii, Temp, bb_temp[rr_max] ;
-	int loop_count ;
-
-	// Determine the number of loops required for parallelism.  
-	loop_count = ceil(nn_shorten / (double)Parallel) ;
-	
-	// Serial to parallel data conversion
-	for (i = 0; i < Parallel; i++) 
-		for (j = 0; j < loop_count; j++) 
-			if (i + j * Parallel < nn_shorten)
-				data_p[i][j] = recd[i + j * Parallel];
-			else
-				data_p[i][j] = 0;
-	
-	// Initialize the parity bits.
-	for (i = 0; i < rr; i++)
-		bb[i] = 0;
-	
-	// Compute syndrome polynomial: S(x) = C(x) mod g(x)
-	// S(t) = T_G_R S(t-1) + R(t) 
-	// Ref: L&C, pp. 225, Fig. 6.11
-	for (iii = loop_count - 1; iii >= 0; iii--) {
-		for (i = 0; i < rr; i++) {
-			Temp = 0;
-			for (j = 0; j < rr; j++) 
-				if (bb[j] !=0 && T_G_R[i][j] != 0)
-					Temp ^= 1 ;
-			bb_temp[i] = Temp;
-		}
-		
-		for (i = 0; i < rr; i++)
-			bb[i] = bb_temp[i];
-		
-		for (i = 0; i < Parallel; i++)
-			bb[i] = bb[i] ^ data_p[i][iii];
-	}
-	
-	// Computation 2t syndromes based on S(x)
-	// Odd syndromes
-	syn_error = 0 ;
-	for (i = 1; i <= ttx2 - 1; i = i+2) {
-	 	s[i] = 0 ;
-		for (j = 0; j < rr; j++)
-			if (bb[j] != 0)
-				s[i] ^= alpha_to[(index_of[bb[j]] + i*j) % nn] ;
-		if (s[i] != 0)
-			syn_error = 1 ;	// set flag if non-zero syndrome => error
-    	}
-
-	// Even syndrome = (Odd syndrome) ** 2
-	for (i = 2; i <= ttx2; i = i + 2) {
-	 	j = i / 2;
-		if (s[j] == 0)
-			s[i] = 0;
-		else
-			s[i] =  alpha_to[(2 * index_of[s[j]]) % nn];
-	}
-	
-	if (Verbose) {
-		fprintf(stdout, "# The syndrome from parallel decoder is:\n") ;
-		for (i = 1; i <= ttx2; i++)
-			fprintf(stdout, "   %4d (%4d) == 0x%04x (0x%x)\n", s[i],index_of[s[i]],s[i], index_of[s[i]]) ;
-		fprintf(stdout, "\n\n") ;
-	}
-}
-
-void decode_bch() {
-	register int i, j, elp_sum ;
-	int L[ttx2+3];			// Degree of ELP 
-	int u_L[ttx2+3];		// Difference between step number and the degree of ELP
-	int reg[tt+3];			// Register state
-	int elp[ttx2+4][ttx2+4]; 	// Error locator polynomial (ELP)
-	int desc[ttx2+4];		// Discrepancy 'mu'th discrepancy
-	int u;				// u = 'mu' + 1 and u ranges from -1 to 2*t (see L&C)
-	int q;				//
-
-	parallel_syndrome() ;
-	
-	if (!syn_error) {
-		decode_flag = 1 ;	// No errors
-		count = 0 ;
-	}
-	else {	
-		// Having errors, begin decoding procedure
-		// Simplified Berlekamp-Massey Algorithm for Binary BCH codes
-		// 	Ref: Blahut, pp.191, Chapter 7.6 
-		// 	Ref: L&C, pp.212, Chapter 6.4
-		//
-		// Following the terminology of Lin and Costello's book:   
-		// 	desc[u] is the 'mu'th discrepancy, where  
-		// 	u='mu'+1 and 
-		// 	'mu' (the Greek letter!) is the step number ranging 
-		// 		from -1 to 2*t (see L&C)
-		// 	l[u] is the degree of the elp at that step, and 
-		// 	u_L[u] is the difference between the step number 
-		// 		and the degree of the elp. 
-		
-		if (Verbose) fprintf(stdout,"Beginning Berlekamp loop\n");
-
-		// initialise table entries
-		for (i = 1; i <= ttx2; i++) 
-			s[i] = index_of[s[i]];
-
-		desc[0] = 0;				/* index form */
-		desc[1] = s[1];				/* index form */
-		elp[0][0] = 1;				/* polynomial form */
-		elp[1][0] = 1;				/* polynomial form */
-		//elp[2][0] = 1;				/* polynomial form */
-		for (i = 1; i < ttx2; i++) {
-			elp[0][i] = 0;			/* polynomial form */
-			elp[1][i] = 0;			/* polynomial form */
-			//elp[2][i] = 0;			/* polynomial form */
-		}
-		L[0] = 0;
-		L[1] = 0;
-		//L[2] = 0;
-		u_L[0] = -1;
-		u_L[1] = 0;
-		//u_L[2] = 0;
-		u = -1; 
- 
-		do {
-			// even loops always produce no discrepany so they can be skipped
-			u = u + 2; 
-			if (Verbose) fprintf(stdout,"Loop %d:\n", u);
-			if (Verbose) fprintf(stdout,"     desc[%d] = %x\n", u, desc[u]);
-			if (desc[u] == -1) {
-				L[u + 2] = L[u];
-				for (i = 0; i <= L[u]; i++)
-					elp[u + 2][i] = elp[u][i]; 
-			}
-			else {
-				// search for words with greatest u_L[q] for which desc[q]!=0 
-				q = u - 2;
-				if (q<0) q=0;
-				// Look for first non-zero desc[q] 
-				while ((desc[q] == -1) && (q > 0))
-					q=q-2;
-				if (q < 0) q = 0;
-
-				// Find q such that desc[u]!=0 and u_L[q] is maximum
-				if (q > 0) {
-					j = q;
-				  	do {
-				    		j=j-2;
-						if (j < 0) j = 0;
-				    		if ((desc[j] != -1) && (u_L[q] < u_L[j]))
-				      			q = j;
-				  	} while (j > 0);
-				}
- 
-				// store degree of new elp polynomial
-				if (L[u] > L[q] + u - q)
-					L[u + 2] = L[u];
-				else
-					L[u + 2] = L[q] + u - q;
- 
-				// Form new elp(x)
-				for (i = 0; i < ttx2; i++) 
-					elp[u + 2][i] = 0;
-				for (i = 0; i <= L[q]; i++) 
-					if (elp[q][i] != 0)
-						elp[u + 2][i + u - q] = alpha_to[(desc[u] + nn - desc[q] + index_of[elp[q][i]]) % nn];
-				for (i = 0; i <= L[u]; i++) 
-					elp[u + 2][i] ^= elp[u][i];
-
-			}
-			u_L[u + 2] = u+1 - L[u + 2];
- 
-			// Form (u+2)th discrepancy.  No discrepancy computed on last iteration 
-			if (u < ttx2) {	
-				if (s[u + 2] != -1)
-					desc[u + 2] = alpha_to[s[u + 2]];
-				else 
-					desc[u + 2] = 0;
-
-				for (i = 1; i <= L[u + 2]; i++) 
-					if ((s[u + 2 - i] != -1) && (elp[u + 2][i] != 0))
-			        		desc[u + 2] ^= alpha_to[(s[u + 2 - i] + index_of[elp[u + 2][i]]) % nn];
-			 	// put desc[u+2] into index form 
-				desc[u + 2] = index_of[desc[u + 2]];	
-
-			}
-
-			if (Verbose) {
-				fprintf(stdout,"     deg(elp) = %2d --> elp(%2d):", L[u], u);
-				for (i=0; i<=L[u]; i++)
-					fprintf(stdout,"  0x%x", elp[u][i]);
-				fprintf(stdout,"\n");
-				fprintf(stdout,"     deg(elp) = %2d --> elp(%2d):", L[u+2], u+2);
-				for (i=0; i<=L[u+2]; i++)
-					fprintf(stdout,"  0x%x", elp[u+2][i]);
-				fprintf(stdout,"\n");
-				fprintf(stdout,"     u_L[%2d] = %2d\n", u, u_L[u]);
-				fprintf(stdout,"     u_L[%2d] = %2d\n", u+2, u_L[u+2]);
-			}
-
-		} while ((u < (ttx2-1)) && (L[u + 2] <= tt)); 
-		if (Verbose) fprintf(stdout,"\n");
-		u=u+2;
-		L[ttx2-1] = L[u];
-		
-		if (L[ttx2-1] > tt) 
-			decode_flag = 0;
-		else {
-			// Chien's search to find roots of the error location polynomial
-			// Ref: L&C pp.216, Fig.6.1
-			if (Verbose) fprintf(stdout,"Chien Search:  L[%d]=%d=%x\n", ttx2-1,L[ttx2-1],L[ttx2-1]);
-			if (Verbose) fprintf(stdout,"Sigma(x) = \n");
-
-			if (Verbose) 
-				for (i = 0; i <= L[u]; i++) 
-					if (elp[u][i] != 0)
-						fprintf(stdout,"    %4d (%4d)\n", elp[u][i], index_of[elp[u][i]]);
-					else
-						fprintf(stdout,"     0\n");
-
-			for (i = 1; i <= L[ttx2-1]; i++) {
-				reg[i] = index_of[elp[u][i]];
-				if (Verbose) fprintf(stdout,"  reg[%d]=%d=%x\n", i,reg[i],reg[i]);
-			}
-			count = 0 ;
-			// Begin chien search 
-			for (i = 1; i <= nn; i++) {
-			 	elp_sum = 1 ;
-				for (j = 1; j <= L[ttx2-1]; j++) 
-					if (reg[j] != -1) {
-					 	reg[j] = (reg[j] + j) % nn ;
-						elp_sum ^= alpha_to[reg[j]] ;
-					}
-
-				// store root and error location number indices
-				if (!elp_sum) {
-					location[count] = nn - i ;
-					if (Verbose) fprintf(stdout,"count: %d location: %d L[ttx2-1] %d\n",
-							count,location[count],L[ttx2-1]);
-					count++ ;
-				}
-			}
-			
-			// Number of roots = degree of elp hence <= tt errors
-			if (count == L[ttx2-1]) {   
-				decode_flag = 1 ;
-				// Correct errors by flipping the error bit
-				for (i = 0; i < L[ttx2-1]; i++) 
-				 	recd[location[i]] ^= 1 ;	
-			}
-			// Number of roots != degree of ELP => >tt errors and cannot solve
-			else 
-				decode_flag = 0 ;
-		}
-	}
-}
-
-int main(int argc,  char** argv)
-{	int i, j ;
-	int Help ;
-	int Input_kk, Output_Syndrome ;			// Input & Output switch
-	int in_count, in_v, in_codeword;		// Input statistics
-	int decode_success, decode_fail;		// Decoding statistics
-	int code_success[kk_max], code_fail[kk_max];	// Decoded and failed words
-	int codeword[kk_max], recd_data[kk_max], recd_parity[kk_max] ;
-	char in_char;
-	
-	fprintf(stderr, "# Binary BCH decoder.  Use -h for details.\n\n");
-	
-	Verbose = 0;
-	Input_kk = 0;
-	Help = 0;
-	mm = df_m;
-	tt = df_t;
-	Parallel = df_p;
-	decode_success = 0; 
-	decode_fail = 0;
-	for (i=1; i < argc;i++) {
-		if (argv[i][0] == '-') {
-			switch (argv[i][1]) {
-				case 'm': mm = atoi(argv[++i]);
-					break;
-				case 't': tt = atoi(argv[++i]);
-					break;
-				case 'p': Parallel = atoi(argv[++i]);
-					break;
-				case 'k': kk_shorten = atoi(argv[++i]);
-					Input_kk = 1;
-					if (kk_shorten % 4 != 0) {
-						fprintf(stderr, "### k must divide 4.\n\n");
-						Help = 1;
-					}
-					break;
-				case 's': Output_Syndrome = 1;
-					break;
-				case 'v': Verbose = 1;
-					break;
-				default: Help = 1;
-			}
-		}
-		else 
-			Help = 1;
-	}
-	
-	if (Help == 1) {
-		fprintf(stdout,"# Usage %s:  BCH decoder\n",argv[0]);
-		fprintf(stdout,"    -h:  This help message\n");
-		fprintf(stdout,"    -m <field>:  Galois field, GF, for code.  Code length is 2^<field>-1.\n");
-		fprintf(stdout,"         The default value is %d for a code length %d.  If the parameter is\n", df_m, (int)pow(2,df_m) - 1);
-		fprintf(stdout,"         set to 0, the program will estimate the value based upon the values\n");
-		fprintf(stdout,"         chosen for k and t.\n");
-		fprintf(stdout,"    -t <correct>:  Correction power of the code.  Default = %d\n", df_t);
-		fprintf(stdout,"    -k <data bits>:  Number of data bits to be encoded. Must divide 4.\n");
-		fprintf(stdout,"         The default value is the maximum supported by the code which\n");
-		fprintf(stdout,"         depends upon the field (-m) and the correction (-t) chosen.\n");
-		fprintf(stdout,"    -p <parallel>:  Parallelism in decoder.  Does not effect results but\n");
-		fprintf(stdout,"         does change the algorithm used to generate them.  Default = %d\n", df_p);
-		fprintf(stdout,"    -s   Syndrome output after the decoded data.  Default disabled. \n");
-		fprintf(stdout,"    -v   Verbose mode.  Output detailed information, such as encoded codeword,\n");
-		fprintf(stdout,"         received codeword and decoded codeword.  Default disabled. \n");
-		fprintf(stdout,"    <stdin>:  character string to decode in hex format.  All other \n");
-		fprintf(stdout,"          characters are ignored.  Comments are enclosed in brackets:  { }.\n");
-		fprintf(stdout,"          The hex values are converted to binary and taken <data bits> \n");
-		fprintf(stdout,"          at a time.\n");
-		fprintf(stdout,"    <stdout>:  resulting decoded character string in hex format.\n");
-		fprintf(stdout,"    <stderr>:  information about the decode process as well as error messages.\n");
-	}
-	else {
-		nn = (int)pow(2, mm) - 1;
-		nn_shorten = nn;
-		
-		// generate the Galois Field GF(2**mm)
-		generate_gf() ;
-		
-		// Compute the generator polynomial and lookahead matrix for BCH code
-		gen_poly() ;
-		
-		// Check if code is shortened
-		if (Input_kk == 1)
-			nn_shorten = kk_shorten + rr ;
-		else {
-			kk_shorten = nn_shorten - rr ;
-			// Make the shortened length divide 4
-			kk_shorten = kk_shorten - kk_shorten % 4 ;
-			nn_shorten = kk_shorten + rr ;
-		}
-		ttx2 = 2 * tt ;
-		
-		fprintf(stdout, "{# (m = %d, n = %d, k = %d, t = %d) Binary BCH code.}\n\n", mm, nn_shorten, kk_shorten, tt) ;
-		
-		// Set input data.	
-		in_count = 0;
-		in_codeword = 0;
-		in_char = getchar();
-		while (in_char != EOF) {
-			if (in_char=='{') {
-				while ((in_char != EOF) && ((char)in_char != '}'))
-					in_char = getchar();
-			}
-			in_v = hextoint(in_char);		
-			if (in_v != -1) {
-				for (i = 3; i >= 0; i--) {
-					if ((int)pow(2,i) & in_v)
-						codeword[in_count] = 1 ;
-					else
-						codeword[in_count] = 0 ;
-					in_count++;
-				}
-			}
-			if (in_count == ceil(nn_shorten / (double)4) * 4) {
-				in_codeword++ ;
-				// Parity check bits
-				for (j = kk_shorten; j < nn_shorten; j++)
-					recd[j - kk_shorten] = codeword[j] ;
-				// Data bits
-				for (j = 0; j < kk_shorten; j++)
-					recd[j + rr] = codeword[j] ;
-
-				decode_bch() ;
-				
-				if ( decode_flag == 1 ) {
-					decode_success++ ;
-					code_success[decode_success] = in_codeword;
-					if (count == 0) 
-						fprintf(stdout, "{ Codeword %d: No errors.}\n", in_codeword) ;
-					else {
-						fprintf(stdout, "{ Codeword %d: %d errors found at location:", in_codeword, count) ;
-						for (i = count - 1; i >= 0 ; i--)  {
-							// Convert error location from systematic form to storage form 
-							if (location[i] >= rr)
-								location[i] = location[i] - rr;
-							else
-								location[i] = location[i] + kk_shorten;
-							
-							fprintf(stdout, " %d", location[i]) ;
-						}
-						fprintf(stdout, "}");
-
-						printf("\n");
-					}
-				}
-				else {
-					decode_fail++ ;
-					code_fail[decode_fail] = in_codeword;
-					fprintf(stdout, "{ Codeword %d: Unable to decode!}", in_codeword) ;
-					printf("\n");
-				}
-				// Convert decoded data into information data and parity checks
-				for (i = 0; i < kk_shorten; i++)
-					recd_data[i] = recd[i + rr];
-				for (i = 0; i < rr; i++)
-					recd_parity[i] = recd[i];
-				print_hex_low(kk_shorten, recd_data, stdout);
-				if (Output_Syndrome == 1) {
-					fprintf(stdout, "    ");
-					print_hex_low(rr, recd_parity, stdout);
-					if (Verbose) fprintf(stdout,"rr: %d\n",rr);
-				}
-				fprintf(stdout, "\n\n");
-				in_count = 0;
-			}
-			in_char = getchar();
-		}
-		
-		fprintf(stdout, "{### %d codewords received.}\n", in_codeword) ;
-		fprintf(stdout, "{@@@ %d codewords are decoded successfully:}\n{", decode_success) ;
-		for (i = 1; i <= decode_success; i++)
-			fprintf(stdout, " %d", code_success[i]);
-		fprintf(stdout, " }\n");
-		fprintf(stdout, "{!!! %d codewords are unable to correct:}\n{", decode_fail) ;
-		for (i = 1; i <= decode_fail; i++)
-			fprintf(stdout, " %d", code_fail[i]);
-		fprintf(stdout, " }\n");
-	}
-	
-	return(0);
-}
+/*******************************************************************************
+*
+*    File Name:  bch_decoder.c
+*     Revision:  2.0
+*         Date:  March, 2007
+*        Email:  nandsupport@micron.com
+*      Company:  Micron Technology, Inc.
+*
+*  Description:  Micron NAND BCH Decoder
+*
+*   References: 
+* 		  1. Error Control Coding, Lin & Costello, 2nd Ed., 2004
+* 		  2. Error Control Codes, Blahut, 1983
+**
+*   Disclaimer   This software code and all associated documentation, comments or other 
+*  of Warranty:  information (collectively "Software") is provided "AS IS" without 
+*                warranty of any kind. MICRON TECHNOLOGY, INC. ("MTI") EXPRESSLY 
+*                DISCLAIMS ALL WARRANTIES EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED 
+*                TO, NONINFRINGEMENT OF THIRD PARTY RIGHTS, AND ANY IMPLIED WARRANTIES 
+*                OF MERCHANTABILITY OR FITNESS FOR ANY PARTICULAR PURPOSE. MTI DOES NOT 
+*                WARRANT THAT THE SOFTWARE WILL MEET YOUR REQUIREMENTS, OR THAT THE 
+*                OPERATION OF THE SOFTWARE WILL BE UNINTERRUPTED OR ERROR-FREE. 
+*                FURTHERMORE, MTI DOES NOT MAKE ANY REPRESENTATIONS REGARDING THE USE OR 
+*                THE RESULTS OF THE USE OF THE SOFTWARE IN TERMS OF ITS CORRECTNESS, 
+*                ACCURACY, RELIABILITY, OR OTHERWISE. THE ENTIRE RISK ARISING OUT OF USE 
+*                OR PERFORMANCE OF THE SOFTWARE REMAINS WITH YOU. IN NO EVENT SHALL MTI, 
+*                ITS AFFILIATED COMPANIES OR THEIR SUPPLIERS BE LIABLE FOR ANY DIRECT, 
+*                INDIRECT, CONSEQUENTIAL, INCIDENTAL, OR SPECIAL DAMAGES (INCLUDING, 
+*                WITHOUT LIMITATION, DAMAGES FOR LOSS OF PROFITS, BUSINESS INTERRUPTION, 
+*                OR LOSS OF INFORMATION) ARISING OUT OF YOUR USE OF OR INABILITY TO USE 
+*                THE SOFTWARE, EVEN IF MTI HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH 
+*                DAMAGES. Because some jurisdictions prohibit the exclusion or 
+*                limitation of liability for consequential or incidental damages, the 
+*                above limitation may not apply to you.
+*
+*                Copyright 2007 Micron Technology, Inc. All rights reserved.
+*
+* Rev  Author			Date		Changes
+* ---  ---------------	----------	-------------------------------
+* 1.0  ZS		08/07/2006	Initial release
+* 2.0  PF		03/05/2007	Fixed bug that caused some codewords
+* 					to not be corrected
+* 
+* 
+/*******************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include "bch.h"
+
+#define pipe_batch  64				// Codewords per batch of the pipeline
+
+int Output_Syndrome ;				// Output switch
+int Verbose ;					// Mode indicator
+int decode_success, decode_fail;		// Decoding statistics
+int soft_success ;				// Of them recovered by --soft
+unsigned char *code_failed ;			// One bit per codeword, set if it failed
+int code_failed_size ;				// Bytes allocated
+volatile sig_atomic_t stats_request ;		// SIGUSR1 received, dump the stats
+uint64_t stats_cycles ;				// bch_cycles() and
+struct timespec stats_time ;			// clock at the start of the decode
+
+void stats_signal(int sig)
+{	(void)sig ;
+	stats_request = 1 ;
+}
+
+void stats_start(void)
+{	struct sigaction sa ;
+
+	memset(&sa, 0, sizeof(sa)) ;
+	sa.sa_handler = stats_signal ;
+	sa.sa_flags = SA_RESTART ;
+	sigaction(SIGUSR1, &sa, NULL) ;
+	clock_gettime(CLOCK_MONOTONIC, &stats_time) ;
+	stats_cycles = bch_cycles() ;
+}
+
+void dump_stats(const bch_ctx *ctx, const bch_pool *pool, const bch_pipe *pipe)
+/* Decoder counters (--stats) as one JSON object on stderr.  The time of
+ * each stage is estimated from the codewords sampled for timing.
+ */
+{	static const char *stage[stat_stages] = { "syndrome", "low_weight", "bm", "chien" } ;
+	bch_stats s ;
+	struct timespec now ;
+	double elapsed, ns_per_cycle, per_call ;
+	uint64_t cycles ;
+	int i ;
+	
+	if (pool)
+		bch_pool_stats(pool, &s) ;
+	else
+		bch_pipe_stats(pipe, &s) ;
+	clock_gettime(CLOCK_MONOTONIC, &now) ;
+	cycles = bch_cycles() - stats_cycles ;
+	elapsed = (now.tv_sec - stats_time.tv_sec) * 1e9 + (now.tv_nsec - stats_time.tv_nsec) ;
+	ns_per_cycle = cycles ? elapsed / cycles : 0 ;
+	
+	fprintf(stderr, "{\"stats\": {\"elapsed_ns\": %.0f, \"ns_per_cycle\": %.4f, \"codewords\": %llu,\n",
+		elapsed, ns_per_cycle, (unsigned long long)s.codewords) ;
+	fprintf(stderr, "  \"stages\": {") ;
+	for (i = 0; i < stat_stages; i++)
+	{	per_call = s.timed[i] ? (double)s.cycles[i] / s.timed[i] : 0 ;
+		fprintf(stderr, "%s\n    \"%s\": {\"calls\": %llu, \"timed\": %llu, \"cycles_per_call\": %.1f, "
+			"\"ns_per_call\": %.1f, \"ns\": %.0f}",
+			i ? "," : "", stage[i], (unsigned long long)s.calls[i], (unsigned long long)s.timed[i],
+			per_call, per_call * ns_per_cycle, per_call * ns_per_cycle * s.calls[i]) ;
+	}
+	fprintf(stderr, "},\n  \"errors\": [") ;
+	for (i = 0; i <= ctx->tt; i++)
+		fprintf(stderr, "%s%llu", i ? ", " : "", (unsigned long long)s.errors[i]) ;
+	fprintf(stderr, "],\n  \"uncorrectable\": %llu, \"bm_iterations\": %llu, \"chien_points\": %llu,\n",
+		(unsigned long long)s.errors[ctx->tt + 1], (unsigned long long)s.bm_iterations,
+		(unsigned long long)s.chien_points) ;
+	// Clean codewords are those with a zero syndrome
+	fprintf(stderr, "  \"clean\": %llu, \"dirty\": %llu, \"clean_ratio\": %.4f}}\n",
+		(unsigned long long)s.errors[0], (unsigned long long)(s.codewords - s.errors[0]),
+		s.codewords ? (double)s.errors[0] / s.codewords : 0) ;
+	fflush(stderr) ;
+}
+
+void poll_stats(const bch_ctx *ctx, const bch_pool *pool, const bch_pipe *pipe)
+/* Dump the stats between batches if SIGUSR1 asked for them */
+{	if (stats_request) {
+		stats_request = 0 ;
+		dump_stats(ctx, pool, pipe) ;
+	}
+}
+
+int mark_codeword(int n, int failed)
+/* Record the result of codeword n, numbered from 1.  Returns -1 if out of
+ * memory.
+ */
+{	unsigned char *grown ;
+	int size ;
+	
+	if (n / 8 >= code_failed_size) {
+		size = code_failed_size ? 2 * code_failed_size : 1024 ;
+		grown = realloc(code_failed, size) ;
+		if (grown == NULL)
+			return -1 ;
+		memset(grown + code_failed_size, 0, size - code_failed_size) ;
+		code_failed = grown ;
+		code_failed_size = size ;
+	}
+	if (failed)
+		code_failed[n / 8] |= 1 << (n % 8) ;
+	return 0 ;
+}
+
+void report_batch(const bch_ctx *ctx, int first, int n, unsigned char *codewords, int stride, int *count, int *location)
+/* Print the results of n decoded codewords, numbered from first, in order */
+{	int i, c ;
+	unsigned char *codeword_packed ;
+	
+	for (c = 0; c < n; c++) {
+		codeword_packed = codewords + (size_t)c * stride ;
+		if ( count[c] >= 0 ) {
+			decode_success++ ;
+			mark_codeword(first + c, 0) ;
+			if (count[c] == 0) 
+				fprintf(stdout, "{ Codeword %d: No errors.}\n", first + c) ;
+			else {
+				fprintf(stdout, "{ Codeword %d: %d errors found at location:", first + c, count[c]) ;
+				for (i = count[c] - 1; i >= 0 ; i--)
+					fprintf(stdout, " %d", location[c * ctx->tt + i]) ;
+				fprintf(stdout, "}");
+
+				printf("\n");
+			}
+		}
+		else {
+			decode_fail++ ;
+			if (mark_codeword(first + c, 1) < 0) {
+				fprintf(stderr, "### Out of memory.\n\n") ;
+				exit(1) ;
+			}
+			fprintf(stdout, "{ Codeword %d: Unable to decode!}", first + c) ;
+			printf("\n");
+		}
+		print_hex_bytes(0, ctx->kk_shorten, codeword_packed, stdout);
+		if (Output_Syndrome == 1) {
+			fprintf(stdout, "    ");
+			print_hex_bytes(ctx->kk_shorten, ctx->rr, codeword_packed, stdout);
+			if (Verbose) fprintf(stdout,"rr: %d\n",ctx->rr);
+		}
+		fprintf(stdout, "\n\n");
+	}
+}
+
+void write_binary(const bch_ctx *ctx, long first, int n, unsigned char *codewords, int record, int *count,
+		  const unsigned char *soft)
+/* Write the corrected data (and parity with -s) of n codewords, numbered
+ * from first + 1 and record bytes apart, and report those that failed, and
+ * those soft decoded if soft is not NULL, on stderr
+ */
+{	int c, stride ;
+	
+	stride = (ctx->nn_shorten + 7) / 8 ;
+	for (c = 0; c < n; c++)
+	{	if (count[c] >= 0)
+		{	decode_success++ ;
+			if (soft && soft[c])
+			{	soft_success++ ;
+				fprintf(stderr, "{ Codeword %ld: %d bits flipped by soft decoding.}\n", first + c + 1, count[c]) ;
+			}
+		}
+		else
+		{	decode_fail++ ;
+			fprintf(stderr, "{ Codeword %ld: Unable to decode!}\n", first + c + 1) ;
+		}
+		if (Output_Syndrome == 0)
+			fwrite(codewords + (size_t)c * record, ctx->kk_shorten / 8, 1, stdout) ;
+		else if (record != stride)
+			fwrite(codewords + (size_t)c * record, stride, 1, stdout) ;
+	}
+	if (Output_Syndrome == 1 && record == stride)
+		fwrite(codewords, stride, n, stdout) ;
+}
+
+int decode_binary(const bch_ctx *ctx, bch_pool *pool, int batch, int *count, int flips)
+/* Decode raw codeword records, data then parity bytes, from stdin and write
+ * the corrected data (and parity with -s) to stdout.  Failed codewords are
+ * reported on stderr.  With flips (--soft) each codeword is followed by its
+ * weak bit map, and one the hard decoder is unable to decode is retried by
+ * Chase-II over its flips weakest bits.  Returns the number of codewords, or
+ * -1 if out of memory.
+ */
+{	int c, i, n, words, stride, record ;
+	bin_input *in ;
+	bch_work *work ;
+	unsigned char *codewords, *weak, *reliability, *soft ;
+	
+	stride = (ctx->nn_shorten + 7) / 8 ;
+	record = flips ? 2 * stride : stride ;
+	in = bin_open(0, record, batch) ;
+	work = flips ? bch_work_new(ctx) : NULL ;
+	reliability = flips ? malloc(ctx->nn_shorten) : NULL ;
+	soft = flips ? malloc(batch) : NULL ;
+	if (in == NULL || (flips && (work == NULL || reliability == NULL || soft == NULL)))
+		return -1 ;
+	
+	words = 0 ;
+	while ((codewords = bin_read(in, &n)), n > 0)
+	{	// Bits past the parity are not part of the codeword
+		if (ctx->nn_shorten % 8)
+			for (c = 0; c < n; c++)
+				codewords[(size_t)c * record + stride - 1] &= 0xff << (8 - ctx->nn_shorten % 8) ;
+		bch_decode_batch(pool, codewords, record, n, count, NULL) ;
+		// Soft decode the few hard failures on this thread
+		for (c = 0; c < n && flips; c++)
+		{	soft[c] = count[c] < 0 ;
+			if (soft[c])
+			{	weak = codewords + (size_t)c * record + stride ;
+				for (i = 0; i < ctx->nn_shorten; i++)
+					reliability[i] = packed_bit(weak, i) ? 0 : 255 ;
+				count[c] = bch_chase(ctx, work, codewords + (size_t)c * record, reliability, flips) ;
+			}
+		}
+		write_binary(ctx, words, n, codewords, record, count, soft) ;
+		words += n ;
+		if (ctx->flags & BCH_STATS)
+			poll_stats(ctx, pool, NULL) ;
+	}
+	if (in->tail_len > 0)
+		fprintf(stderr, "### %zu trailing bytes of a partial codeword ignored.\n", in->tail_len) ;
+	
+	bin_close(in) ;
+	bch_work_free(work) ;
+	free(reliability) ;
+	free(soft) ;
+	return words ;
+}
+
+int decode_pages(const bch_ctx *ctx, bch_pool *pool, const bch_page_layout *layout, int batch, int *count)
+/* Decode raw NAND pages (--page) from stdin and write the data of their
+ * sectors, or with -s the whole corrected page, to stdout.  Returns the
+ * number of pages, or -1 if out of memory.
+ */
+{	int p, i, n, pages, data_bytes ;
+	bin_input *in ;
+	bch_page *pg ;
+	unsigned char *page ;
+	
+	data_bytes = ctx->kk_shorten / 8 ;
+	in = bin_open(0, layout->page_bytes, batch) ;
+	pg = bch_page_new(ctx, layout, batch, pool) ;
+	if (in == NULL || pg == NULL)
+		return -1 ;
+	
+	pages = 0 ;
+	while ((page = bin_read(in, &n)), n > 0)
+	{	bch_page_decode(pg, page, n, count) ;
+		for (p = 0; p < n; p++)
+			for (i = 0; i < layout->sectors; i++)
+			{	if (count[p * layout->sectors + i] >= 0)
+					decode_success++ ;
+				else
+				{	decode_fail++ ;
+					fprintf(stderr, "{ Page %d sector %d: Unable to decode!}\n", pages + p + 1, i) ;
+				}
+				if (Output_Syndrome == 0)
+					fwrite(page + (size_t)p * layout->page_bytes + layout->data_offset + (size_t)i * layout->data_stride,
+					       data_bytes, 1, stdout) ;
+			}
+		if (Output_Syndrome == 1)
+			fwrite(page, layout->page_bytes, n, stdout) ;
+		pages += n ;
+		if (ctx->flags & BCH_STATS)
+			poll_stats(ctx, pool, NULL) ;
+	}
+	if (in->tail_len > 0)
+		fprintf(stderr, "### %zu trailing bytes of a partial page ignored.\n", in->tail_len) ;
+	
+	bin_close(in) ;
+	bch_page_free(pg) ;
+	return pages ;
+}
+
+typedef struct {
+	const bch_ctx *ctx ;
+	hex_input *hex ;		// Hex text input, or
+	bin_input *bin ;		// raw binary input (--binary)
+	bch_pipe *pipe ;
+} stream ;
+
+int stream_read(void *arg, unsigned char *codewords, int max)
+/* Reader thread of the pipeline:  up to max codewords from stdin.  A partial
+ * codeword at the end of the input is dropped.
+ */
+{	stream *st = arg ;
+	const bch_ctx *ctx = st->ctx ;
+	unsigned char *records ;
+	int c, n, stride, nibbles ;
+	
+	stride = (ctx->nn_shorten + 7) / 8 ;
+	if (st->bin) {
+		records = bin_read(st->bin, &n) ;
+		memcpy(codewords, records, (size_t)n * stride) ;
+	}
+	else {
+		nibbles = (ctx->nn_shorten + 3) / 4 ;
+		for (n = 0; n < max; n++)
+			if (hex_read(st->hex, codewords + (size_t)n * stride, nibbles, 0) != nibbles)
+				break ;
+	}
+	// Bits past the parity are not part of the codeword
+	if (ctx->nn_shorten % 8)
+		for (c = 0; c < n; c++)
+			codewords[(size_t)c * stride + stride - 1] &= 0xff << (8 - ctx->nn_shorten % 8) ;
+	return n ;
+}
+
+void stream_write(void *arg, long first, int n, unsigned char *codewords, int *count, int *location)
+/* Writer of the pipeline, called in input order */
+{	stream *st = arg ;
+	
+	if (st->bin)
+		write_binary(st->ctx, first, n, codewords, (st->ctx->nn_shorten + 7) / 8, count, NULL) ;
+	else
+		report_batch(st->ctx, first + 1, n, codewords, (st->ctx->nn_shorten + 7) / 8, count, location) ;
+	if (st->ctx->flags & BCH_STATS)
+		poll_stats(st->ctx, NULL, st->pipe) ;
+}
+
+long decode_stream(const bch_ctx *ctx, bch_pipe *pipe, int binary)
+/* Decode stdin on the pipeline (--pipeline):  parsing, decoding and output
+ * overlap.  Returns the number of codewords, or -1 if out of memory.
+ */
+{	stream st ;
+	long words ;
+	
+	memset(&st, 0, sizeof(st)) ;
+	st.ctx = ctx ;
+	st.pipe = pipe ;
+	if (binary)
+		st.bin = bin_open(0, (ctx->nn_shorten + 7) / 8, pipe_batch) ;
+	else
+		st.hex = hex_open(0) ;
+	if (st.bin == NULL && st.hex == NULL)
+		return -1 ;
+	
+	words = bch_pipe_run(pipe, stream_read, stream_write, &st) ;
+	if (st.bin) {
+		if (st.bin->tail_len > 0)
+			fprintf(stderr, "### %zu trailing bytes of a partial codeword ignored.\n", st.bin->tail_len) ;
+		bin_close(st.bin) ;
+	}
+	hex_close(st.hex) ;
+	return words ;
+}
+
+int main(int argc,  char** argv)
+{	int i ;
+	int Help ;
+	int Input_kk ;					// Input switch
+	int mm, tt, kk_shorten, nn_shorten, Parallel ;	// BCH code parameters
+	int flags ;					// bch_init() options
+	int Binary ;					// Raw binary input and output
+	int Threads ;					// Decoder threads
+	int Pipeline ;					// Overlap input, decoding and output
+	int Sectors, Spare_offset, Interleaved ;	// NAND page layout (--page)
+	int Soft ;					// Chase-II flips (--soft)
+	bch_page_layout layout ;
+	char *Kernel ;					// GF kernel name, NULL for the best supported
+	const gf_kernel *gf ;
+	bch_ctx *ctx ;					// Code context
+	bch_pool *pool ;				// Decoder threads and their scratch state
+	bch_pipe *pipe ;				// or the pipeline with --pipeline
+	int batch, stride, in_batch ;			// Codewords per batch, bytes per codeword
+	unsigned char *codewords ;			// Received data then parity, MSB first
+	unsigned char *codeword_packed ;		// Codeword being read
+	int *count, *location ;				// Decoder results of the batch
+	hex_input *in ;					// Hex text on stdin
+	int in_count, in_codeword;			// Input statistics
+	
+	fprintf(stderr, "# Binary BCH decoder.  Use -h for details.\n\n");
+	
+	Verbose = 0;
+	Input_kk = 0;
+	Output_Syndrome = 0;
+	flags = BCH_CACHE;
+	Threads = 1;
+	kk_shorten = 0;
+	Binary = 0;
+	Pipeline = 0;
+	Sectors = 0;
+	Soft = 0;
+	Spare_offset = 0;
+	Interleaved = 0;
+	Kernel = NULL;
+	Help = 0;
+	mm = df_m;
+	tt = df_t;
+	Parallel = df_p;
+	decode_success = 0; 
+	decode_fail = 0;
+	soft_success = 0;
+	for (i=1; i < argc;i++) {
+		if (argv[i][0] == '-') {
+			switch (argv[i][1]) {
+				case 'm': mm = atoi(argv[++i]);
+					break;
+				case 't': tt = atoi(argv[++i]);
+					break;
+				case 'p': Parallel = atoi(argv[++i]);
+					break;
+				case 'k': kk_shorten = atoi(argv[++i]);
+					Input_kk = 1;
+					if (kk_shorten % 4 != 0) {
+						fprintf(stderr, "### k must divide 4.\n\n");
+						Help = 1;
+					}
+					break;
+				case 's': Output_Syndrome = 1;
+					break;
+				case 'v': Verbose = 1;
+					flags |= BCH_VERBOSE;
+					break;
+				case 'l': flags |= BCH_LOOKAHEAD;
+					break;
+				case 'd': flags |= BCH_DIRECT;
+					break;
+				case 'i': flags |= BCH_INVERSIONLESS;
+					break;
+				case 'g': Kernel = argv[++i];
+					break;
+				case 'j': Threads = atoi(argv[++i]);
+					if (Threads < 1)
+						Help = 1;
+					break;
+				case '-': if (strcmp(argv[i], "--binary") == 0)
+						Binary = 1;
+					else if (strcmp(argv[i], "--stats") == 0)
+						flags |= BCH_STATS;
+					else if (strcmp(argv[i], "--pipeline") == 0)
+						Pipeline = 1;
+					else if (strcmp(argv[i], "--page") == 0 && i + 1 < argc) {
+						Sectors = atoi(argv[++i]);
+						Binary = 1;
+						if (Sectors < 1)
+							Help = 1;
+					}
+					else if (strcmp(argv[i], "--spare-offset") == 0 && i + 1 < argc) {
+						Spare_offset = atoi(argv[++i]);
+						if (Spare_offset < 0)
+							Help = 1;
+					}
+					else if (strcmp(argv[i], "--interleaved") == 0)
+						Interleaved = 1;
+					else if (strcmp(argv[i], "--soft") == 0 && i + 1 < argc) {
+						Soft = atoi(argv[++i]);
+						Binary = 1;
+						if (Soft < 1 || Soft > chase_max)
+							Help = 1;
+					}
+					else
+						Help = 1;
+					break;
+				default: Help = 1;
+			}
+		}
+		else 
+			Help = 1;
+	}
+	
+	if (Binary && Verbose) {
+		fprintf(stderr, "### -v writes its traces to stdout and cannot be used with --binary.\n\n");
+		Help = 1;
+	}
+	if ((Pipeline != 0) + (Sectors != 0) + (Soft != 0) > 1) {
+		fprintf(stderr, "### Only one of --pipeline, --page and --soft can be used.\n\n");
+		Help = 1;
+	}
+	if (Pipeline && Verbose) {
+		fprintf(stderr, "### -v traces each codeword as it is decoded and cannot be used with --pipeline.\n\n");
+		Help = 1;
+	}
+	
+	if (Help == 0 && gf_select_kernel(Kernel, mm, &gf) < 0) {
+		fprintf(stderr, "### GF kernel %s is not supported.\n\n", Kernel);
+		Help = 1;
+	}
+	
+	if (Help == 1) {
+		fprintf(stdout,"# Usage %s:  BCH decoder\n",argv[0]);
+		fprintf(stdout,"    -h:  This help message\n");
+		fprintf(stdout,"    -m <field>:  Galois field, GF, for code.  Code length is 2^<field>-1.\n");
+		fprintf(stdout,"         The default value is %d for a code length %d.  If the parameter is\n", df_m, (int)pow(2,df_m) - 1);
+		fprintf(stdout,"         set to 0, the program will estimate the value based upon the values\n");
+		fprintf(stdout,"         chosen for k and t.\n");
+		fprintf(stdout,"    -t <correct>:  Correction power of the code.  Default = %d\n", df_t);
+		fprintf(stdout,"    -k <data bits>:  Number of data bits to be encoded. Must divide 4.\n");
+		fprintf(stdout,"         The default value is the maximum supported by the code which\n");
+		fprintf(stdout,"         depends upon the field (-m) and the correction (-t) chosen.\n");
+		fprintf(stdout,"    -p <parallel>:  Parallelism in decoder.  Does not effect results but\n");
+		fprintf(stdout,"         does change the algorithm used to generate them.  Default = %d\n", df_p);
+		fprintf(stdout,"         Sets the bits per step of the lookahead syndrome computation (-l)\n");
+		fprintf(stdout,"         and the positions per step of the scalar Chien search; the default\n");
+		fprintf(stdout,"         table driven syndrome computation always consumes 64 bits per step.\n");
+		fprintf(stdout,"    -l   Use the bit-serial lookahead matrix syndrome computation.\n");
+		fprintf(stdout,"         Default disabled. \n");
+		fprintf(stdout,"    -d   Evaluate the syndromes directly from the received bytes with\n");
+		fprintf(stdout,"         per-syndrome byte tables, skipping S(x) = r(x) mod g(x).\n");
+		fprintf(stdout,"         Default disabled. \n");
+		fprintf(stdout,"    -i   Solve the key equation with the inversionless Berlekamp-Massey\n");
+		fprintf(stdout,"         algorithm:  exactly t iterations and no field inversions.\n");
+		fprintf(stdout,"         Default disabled. \n");
+		fprintf(stdout,"    -g <kernel>:  GF(2^m) kernel for the syndromes and Chien search:  scalar,\n");
+		fprintf(stdout,"         ssse3, avx2 or gfni.  Default is the best the CPU supports.\n");
+		fprintf(stdout,"    -j <threads>:  Decode batches of codewords on a work-stealing pool of\n");
+		fprintf(stdout,"         threads.  Output is in input order.  Default = 1\n");
+		fprintf(stdout,"    -s   Syndrome output after the decoded data.  Default disabled. \n");
+		fprintf(stdout,"    -v   Verbose mode.  Output detailed information, such as encoded codeword,\n");
+		fprintf(stdout,"         received codeword and decoded codeword.  Default disabled. \n");
+		fprintf(stdout,"    --binary:  Raw binary input and output.  <stdin> holds codewords of\n");
+		fprintf(stdout,"         <data bits> / 8 data bytes then (<r> + 7) / 8 parity bytes and is\n");
+		fprintf(stdout,"         memory mapped when it is a file.  The corrected data (and parity\n");
+		fprintf(stdout,"         with -s) is written to <stdout>, the report to <stderr>.\n");
+		fprintf(stdout,"         <data bits> must divide 8.  Default disabled. \n");
+		fprintf(stdout,"    --page <sectors>:  Raw NAND pages of <sectors> codewords, --binary\n");
+		fprintf(stdout,"         implied.  The sectors of a page are decoded together and the\n");
+		fprintf(stdout,"         data of each (the whole corrected page with -s) is written to\n");
+		fprintf(stdout,"         <stdout>.  By default the sectors fill the main area and their\n");
+		fprintf(stdout,"         parity follows in the spare area.  Default disabled. \n");
+		fprintf(stdout,"    --spare-offset <bytes>:  Bytes at the start of the spare area before\n");
+		fprintf(stdout,"         the parity, such as the bad block marker.  Default = 0\n");
+		fprintf(stdout,"    --interleaved:  Each sector is followed by its parity in the page.\n");
+		fprintf(stdout,"         Default disabled. \n");
+		fprintf(stdout,"    --soft <flips>:  Soft decision decoding, --binary implied.  Each codeword\n");
+		fprintf(stdout,"         on <stdin> is followed by a map of its weak bits, same layout, set\n");
+		fprintf(stdout,"         where a second read disagreed.  A codeword the hard decoder is\n");
+		fprintf(stdout,"         unable to decode is retried with the 2^<flips> patterns of its\n");
+		fprintf(stdout,"         <flips> weakest bits (Chase-II), at most %d.  Default disabled. \n", chase_max);
+		fprintf(stdout,"    --pipeline:  Read, decode and write on separate threads:  a reader parses\n");
+		fprintf(stdout,"         <stdin> into batches of %d codewords, the -j threads decode them\n", pipe_batch);
+		fprintf(stdout,"         and the main thread writes them in input order.  Default disabled. \n");
+		fprintf(stdout,"    --stats:  Count and time the decoder stages and write them to <stderr>\n");
+		fprintf(stdout,"         as JSON at the end of the input, and after the current batch on\n");
+		fprintf(stdout,"         SIGUSR1.  One codeword in %d is timed.  Default disabled. \n", stat_sample + 1);
+		fprintf(stdout,"    The code tables are cached in $BCH_CACHE_DIR (default ~/.cache/bch) for\n");
+		fprintf(stdout,"    the next run; set it empty to disable the cache.\n");
+		fprintf(stdout,"    <stdin>:  character string to decode in hex format.  All other \n");
+		fprintf(stdout,"          characters are ignored.  Comments are enclosed in brackets:  { }.\n");
+		fprintf(stdout,"          The hex values are converted to binary and taken <data bits> \n");
+		fprintf(stdout,"          at a time.\n");
+		fprintf(stdout,"    <stdout>:  resulting decoded character string in hex format.\n");
+		fprintf(stdout,"    <stderr>:  information about the decode process as well as error messages.\n");
+	}
+	else {
+		// Galois field, generator polynomial and decoder tables
+		ctx = bch_init(mm, tt, Input_kk ? kk_shorten : 0, Parallel, flags, Kernel) ;
+		if (ctx == NULL) {
+			fprintf(stderr, "### Unsupported code:  m = %d, t = %d, k = %d.\n\n", mm, tt, kk_shorten) ;
+			return(1);
+		}
+		kk_shorten = ctx->kk_shorten ;
+		nn_shorten = ctx->nn_shorten ;
+		
+		// Verbose traces are printed by the decoder, so keep them with their codeword
+		if (Verbose)
+			Threads = 1 ;
+		batch = Verbose ? 1 : 256 * Threads ;
+		stride = (nn_shorten + 7) / 8 ;
+		pool = Pipeline ? NULL : bch_pool_new(ctx, Threads) ;
+		pipe = Pipeline ? bch_pipe_new(ctx, Threads, pipe_batch) : NULL ;
+		codewords = malloc((size_t)batch * stride) ;
+		count = malloc(batch * sizeof(int)) ;
+		location = malloc((size_t)batch * tt * sizeof(int)) ;
+		if ((pool == NULL && pipe == NULL) || codewords == NULL || count == NULL || location == NULL) {
+			fprintf(stderr, "### Out of memory.\n\n") ;
+			return(1);
+		}
+		if (Verbose)
+			fprintf(stderr, "# GF kernel: %s\n\n", ctx->gf ? ctx->gf->name : "scalar") ;
+		if (flags & BCH_STATS)
+			stats_start() ;
+		
+		if (Binary) {
+			if (kk_shorten % 8 != 0) {
+				fprintf(stderr, "### k must divide 8 with --binary.\n\n") ;
+				return(1);
+			}
+			fprintf(stderr, "{# (m = %d, n = %d, k = %d, t = %d) Binary BCH code.}\n\n", mm, nn_shorten, kk_shorten, tt) ;
+			if (Sectors) {
+				if (Interleaved)
+					bch_page_layout_interleaved(ctx, &layout, Sectors) ;
+				else
+					bch_page_layout_spare(ctx, &layout, Sectors, Spare_offset) ;
+				fprintf(stderr, "{# %d sectors in a page of %d bytes.}\n\n", Sectors, layout.page_bytes) ;
+				// As many whole pages as the codewords of a batch
+				batch = batch / Sectors + 1 ;
+				free(count) ;
+				count = malloc((size_t)batch * Sectors * sizeof(int)) ;
+				in_codeword = count ? decode_pages(ctx, pool, &layout, batch, count) : -1 ;
+				if (in_codeword >= 0)
+					fprintf(stderr, "{### %d pages received.}\n", in_codeword) ;
+				in_codeword *= Sectors ;
+			}
+			else
+				in_codeword = Pipeline ? decode_stream(ctx, pipe, 1) : decode_binary(ctx, pool, batch, count, Soft) ;
+			if (in_codeword < 0) {
+				fprintf(stderr, "### Out of memory.\n\n") ;
+				return(1);
+			}
+			fprintf(stderr, "{### %d codewords received.}\n", in_codeword) ;
+			fprintf(stderr, "{@@@ %d codewords are decoded successfully.}\n", decode_success) ;
+			fprintf(stderr, "{!!! %d codewords are unable to correct.}\n", decode_fail) ;
+			if (Soft)
+				fprintf(stderr, "{+++ %d codewords recovered by soft decoding.}\n", soft_success) ;
+			if (flags & BCH_STATS)
+				dump_stats(ctx, pool, pipe) ;
+			free(codewords) ;
+			free(count) ;
+			free(location) ;
+			bch_pool_free(pool) ;
+			bch_pipe_free(pipe) ;
+			bch_free(ctx) ;
+			return(0);
+		}
+		
+		fprintf(stdout, "{# (m = %d, n = %d, k = %d, t = %d) Binary BCH code.}\n\n", mm, nn_shorten, kk_shorten, tt) ;
+		
+		if (Pipeline) {
+			in_codeword = decode_stream(ctx, pipe, 0) ;
+			if (in_codeword < 0) {
+				fprintf(stderr, "### Out of memory.\n\n") ;
+				return(1);
+			}
+		}
+		else {
+			// Set input data.	
+			in_codeword = 0;
+			in_batch = 0;
+			codeword_packed = codewords ;
+			in = hex_open(0) ;
+			if (in == NULL) {
+				fprintf(stderr, "### Out of memory.\n\n") ;
+				return(1);
+			}
+			// A partial codeword at the end of the input is dropped
+			while ((in_count = hex_read(in, codeword_packed, (nn_shorten + 3) / 4, 0)) == (nn_shorten + 3) / 4) {
+				in_codeword++ ;
+				// Bits past the parity are not part of the codeword
+				if (nn_shorten % 8)
+					codeword_packed[(nn_shorten - 1) >> 3] &= 0xff << (7 - ((nn_shorten - 1) & 7)) ;
+			
+				// Decode and report a full batch
+				if (++in_batch == batch) {
+					bch_decode_batch(pool, codewords, stride, in_batch, count, location) ;
+					report_batch(ctx, in_codeword - in_batch + 1, in_batch, codewords, stride, count, location) ;
+					in_batch = 0 ;
+					if (flags & BCH_STATS)
+						poll_stats(ctx, pool, NULL) ;
+				}
+				codeword_packed = codewords + (size_t)in_batch * stride ;
+			}
+			hex_close(in) ;
+			if (in_batch > 0) {
+				bch_decode_batch(pool, codewords, stride, in_batch, count, location) ;
+				report_batch(ctx, in_codeword - in_batch + 1, in_batch, codewords, stride, count, location) ;
+			}
+		}
+		
+		fprintf(stdout, "{### %d codewords received.}\n", in_codeword) ;
+		fprintf(stdout, "{@@@ %d codewords are decoded successfully:}\n{", decode_success) ;
+		for (i = 1; i <= in_codeword; i++)
+			if (i / 8 >= code_failed_size || !(code_failed[i / 8] & (1 << (i % 8))))
+				fprintf(stdout, " %d", i);
+		fprintf(stdout, " }\n");
+		fprintf(stdout, "{!!! %d codewords are unable to correct:}\n{", decode_fail) ;
+		for (i = 1; i <= in_codeword; i++)
+			if (i / 8 < code_failed_size && (code_failed[i / 8] & (1 << (i % 8))))
+				fprintf(stdout, " %d", i);
+		fprintf(stdout, " }\n");
+		if (flags & BCH_STATS) {
+			fflush(stdout) ;
+			dump_stats(ctx, pool, pipe) ;
+		}
+		
+		free(codewords) ;
+		free(count) ;
+		free(location) ;
+		free(code_failed) ;
+		bch_pool_free(pool) ;
+		bch_pipe_free(pipe) ;
+		bch_free(ctx) ;
+	}
+	
+	return(0);
+}
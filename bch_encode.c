@@ -0,0 +1,179 @@
+/*******************************************************************************
+*
+*    File Name:  bch_encode.c
+*
+*  Description:  libbch encoder
+*
+*     Function:   1. Table driven parity on packed data (default)
+*		  2. Bit-serial parallel parity with the lookahead matrix
+*		     (BCH_LOOKAHEAD)
+*		  3. Bit-sliced lookahead parity of 64 codewords at once
+*		     (bch_encode_batch() with BCH_LOOKAHEAD)
+*
+*   References: 
+* 		  1. Error Control Coding, Lin & Costello, 2nd Ed., 2004
+* 		  2. Parallel CRC, Shieh, 2001
+*
+*******************************************************************************/
+
+#include <string.h>
+#include "bch.h"
+
+static void parallel_encode_bch(const bch_ctx *ctx, bch_work *w, const unsigned char *data)
+/* Parallel computation of n - k parity check bits.
+ * Use lookahead matrix T_G_R.
+ * The incoming streams are fed into registers from the right hand; substream
+ * i of step iii is data bit i + iii * Parallel, read from the packed data.
+ */
+{	int i, j, iii, Temp, bb_temp[rr_max] ;
+	int loop_count ;
+	int rr = ctx->rr, Parallel = ctx->Parallel, kk_shorten = ctx->kk_shorten ;
+	int *bb = w->bb ;
+	const int *row = ctx->T_G_R_row, *col = ctx->T_G_R_col ;
+	
+	// Determine the number of loops required for parallelism.  
+	loop_count = (kk_shorten + Parallel - 1) / Parallel ;	
+	
+	// Initialize the parity bits.
+	for (i = 0; i < rr; i++)
+		bb[i] = 0;
+	
+	// Compute parity checks
+	// S(t) = T_G_R [ S(t-1) + M(t) ]
+	// Ref: Parallel CRC, Shieh, 2001
+	for (iii = loop_count - 1; iii >= 0; iii--)
+	{	for (i = 0; i < rr; i++)
+			bb_temp[i] = bb[i] ;
+		for (i = Parallel - 1; i >= 0; i--)
+			if (i + iii * Parallel < kk_shorten)
+				bb_temp[rr - Parallel + i] ^= packed_bit(data, i + iii * Parallel) ;
+		
+		for (i = 0; i < rr; i++)
+		{	Temp = 0;
+			for (j = row[i]; j < row[i + 1]; j++)
+				Temp = Temp ^ bb_temp[col[j]];
+			bb[i] = Temp;
+		}
+	}
+	
+}
+
+static void packed_encode_bch(const bch_ctx *ctx, const unsigned char *data, unsigned char *parity)
+/* Table driven computation of n - k parity check bits on packed data.
+ * Consumes 64 data bits per step through the slicing-by-8 remainder tables
+ * built from gg(x), independent of Parallel.
+ */
+{	uint64_t rem[rem_words_max] ;
+	
+	if (ctx->fixed)
+		ctx->fixed->remainder(ctx, data, rem) ;
+	else
+		packed_remainder(ctx, data, (ctx->kk_shorten + 7) / 8, rem) ;
+	remainder_to_bytes(ctx, rem, parity) ;
+}
+
+void bch_encode(const bch_ctx *ctx, bch_work *w, const unsigned char *data, unsigned char *parity)
+/* Parity of kk_shorten packed data bits into (rr + 7) / 8 bytes.  Bits of
+ * a trailing half byte of data past kk_shorten must be zero.
+ */
+{	if (ctx->flags & BCH_LOOKAHEAD)
+	{	parallel_encode_bch(ctx, w, data) ;
+		pack_bits(ctx->rr, w->bb, parity) ;
+	}
+	else
+		packed_encode_bch(ctx, data, parity) ;
+}
+
+static void transpose64(uint64_t *a)
+/* Transpose a 64x64 bit matrix in place, MSB first:  bit 63-c of row r
+ * swaps with bit 63-r of row c.
+ * Ref: Hacker's Delight, Warren, 2nd Ed., 7-3
+ */
+{	uint64_t m, t ;
+	int j, k ;
+	
+	for (j = 32, m = 0x00000000ffffffffULL; j; j >>= 1, m ^= m << j)
+		for (k = 0; k < 64; k = ((k | j) + 1) & ~j)
+		{	t = (a[k] ^ (a[k | j] >> j)) & m ;
+			a[k] ^= t ;
+			a[k | j] ^= t << j ;
+		}
+}
+
+static void sliced_encode_bch(const bch_ctx *ctx, bch_work *w, const unsigned char *data, int data_stride,
+			      int n, unsigned char *parity, int parity_stride)
+/* Lookahead parity of n <= 64 codewords, bit-sliced:  bit 63-c of every
+ * word belongs to codeword c, so S(t) = T_G_R [ S(t-1) + M(t) ] is one XOR
+ * of whole words per set entry of T_G_R for all 64 codewords.
+ */
+{	uint64_t block[64], bb[rr_max], bb_temp[rr_max], v ;
+	int i, j, b, c, iii, nb, bytes, loop_count ;
+	int rr = ctx->rr, Parallel = ctx->Parallel, kk_shorten = ctx->kk_shorten ;
+	const int *row = ctx->T_G_R_row, *col = ctx->T_G_R_col ;
+	uint64_t *slice_data = w->slice_data ;
+	
+	// Transpose the data, 64 bits of 64 codewords at a time
+	nb = (kk_shorten + 7) / 8 ;
+	loop_count = (kk_shorten + Parallel - 1) / Parallel ;
+	for (b = 0; b < (kk_shorten + 63) / 64; b++)
+	{	bytes = nb - 8 * b < 8 ? nb - 8 * b : 8 ;
+		for (c = 0; c < 64; c++)
+		{	v = 0 ;
+			if (c < n)
+				for (j = 0; j < bytes; j++)
+					v |= (uint64_t)data[(size_t)c * data_stride + 8 * b + j] << (56 - 8 * j) ;
+			block[c] = v ;
+		}
+		transpose64(block) ;
+		memcpy(slice_data + 64 * b, block, sizeof(block)) ;
+	}
+	for (i = 64 * ((kk_shorten + 63) / 64); i < loop_count * Parallel; i++)
+		slice_data[i] = 0 ;
+	
+	// Compute parity checks
+	// S(t) = T_G_R [ S(t-1) + M(t) ]
+	// Ref: Parallel CRC, Shieh, 2001
+	for (i = 0; i < rr; i++)
+		bb[i] = 0 ;
+	for (iii = loop_count - 1; iii >= 0; iii--)
+	{	for (i = 0; i < rr; i++)
+			bb_temp[i] = bb[i] ;
+		for (i = 0; i < Parallel; i++)
+			bb_temp[rr - Parallel + i] ^= slice_data[iii * Parallel + i] ;
+		
+		for (i = 0; i < rr; i++)
+		{	v = 0 ;
+			for (j = row[i]; j < row[i + 1]; j++)
+				v ^= bb_temp[col[j]] ;
+			bb[i] = v ;
+		}
+	}
+	
+	// Transpose the parity back, 64 bits at a time
+	nb = (rr + 7) / 8 ;
+	for (b = 0; b < (rr + 63) / 64; b++)
+	{	for (i = 0; i < 64; i++)
+			block[i] = 64 * b + i < rr ? bb[64 * b + i] : 0 ;
+		transpose64(block) ;
+		bytes = nb - 8 * b < 8 ? nb - 8 * b : 8 ;
+		for (c = 0; c < n; c++)
+			for (j = 0; j < bytes; j++)
+				parity[(size_t)c * parity_stride + 8 * b + j] = block[c] >> (56 - 8 * j) ;
+	}
+}
+
+void bch_encode_batch(const bch_ctx *ctx, bch_work *w, const unsigned char *data, int data_stride,
+		      int n, unsigned char *parity, int parity_stride)
+/* Parity of n codewords as bch_encode().  With BCH_LOOKAHEAD the codewords
+ * are encoded 64 at a time by the bit-sliced lookahead encoder.
+ */
+{	int c ;
+	
+	if (ctx->flags & BCH_LOOKAHEAD)
+		for (c = 0; c < n; c += 64)
+			sliced_encode_bch(ctx, w, data + (size_t)c * data_stride, data_stride,
+					  n - c < 64 ? n - c : 64, parity + (size_t)c * parity_stride, parity_stride) ;
+	else
+		for (c = 0; c < n; c++)
+			packed_encode_bch(ctx, data + (size_t)c * data_stride, parity + (size_t)c * parity_stride) ;
+}
@@ -1,235 +1,371 @@
-/*******************************************************************************
-*
-*    File Name:  bch_encoder.c
-*     Revision:  1.0
-*         Date:  August, 2006
-*        Email:  nandsupport@micron.com
-*      Company:  Micron Technology, Inc.
-*
-*  Description:  Micron NAND BCH Encoder
-*
-*   References: 
-* 		  1. Error Control Coding, Lin & Costello, 2nd Ed., 2004
-* 		  2. Error Control Codes, Blahut, 1983
-**
-*   Disclaimer   This software code and all associated documentation, comments or other 
-*  of Warranty:  information (collectively "Software") is provided "AS IS" without 
-*                warranty of any kind. MICRON TECHNOLOGY, INC. ("MTI") EXPRESSLY 
-*                DISCLAIMS ALL WARRANTIES EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED 
-*                TO, NONINFRINGEMENT OF THIRD PARTY RIGHTS, AND ANY IMPLIED WARRANTIES 
-*                OF MERCHANTABILITY OR FITNESS FOR ANY PARTICULAR PURPOSE. MTI DOES NOT 
-*                WARRANT THAT THE SOFTWARE WILL MEET YOUR REQUIREMENTS, OR THAT THE 
-*                OPERATION OF THE SOFTWARE WILL BE UNINTERRUPTED OR ERROR-FREE. 
-*                FURTHERMORE, MTI DOES NOT MAKE ANY REPRESENTATIONS REGARDING THE USE OR 
-*                THE RESULTS OF THE USE OF THE SOFTWARE IN TERMS OF ITS CORRECTNESS, 
-*                ACCURACY, RELIABILITY, OR OTHERWISE. THE ENTIRE RISK ARISING OUT OF USE 
-*                OR PERFORMANCE OF THE SOFTWARE REMAINS WITH YOU. IN NO EVENT SHALL MTI, 
-*                ITS AFFILIATED COMPANIES OR THEIR SUPPLIERS BE LIABLE FOR ANY DIRECT, 
-*                INDIRECT, CONSEQUENTIAL, INCIDENTAL, OR SPECIAL DAMAGES (INCLUDING, 
-*                WITHOUT LIMITATION, DAMAGES FOR LOSS OF PROFITS, BUSINESS INTERRUPTION, 
-*                OR LOSS OF INFORMATION) ARISING OUT OF YOUR USE OF OR INABILITY TO USE 
-*                THE SOFTWARE, EVEN IF MTI HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH 
-*                DAMAGES. Because some jurisdictions prohibit the exclusion or 
-*                limitation of liability for consequential or incidental damages, the 
-*                above limitation may not apply to you.
-*
-*                Copyright 2006 Micron Technology, Inc. All rights reserved.
-*
-* Rev  Author			Date		Changes
-* ---  ---------------	----------	-------------------------------
-* 1.0  ZS		08/07/2006	Initial release
-* 
-* 
-/*******************************************************************************/
-
-
-#include "bch_global.c"
-
-int bb[rr_max] ;		// Parity checks
-
-void parallel_encode_bch()
-/* Parallel computation of n - k parity check bits.
- * Use lookahead matrix T_G_R.
- * The incoming streams are fed into registers from the right hand
- */
-{	int i, j, iii, Temp, bb_temp[rr_max] ;
-	int loop_count ;
-	
-	// Determine the number of loops required for parallelism.  
-	loop_count = ceil(kk_shorten / (double)Parallel) ;	
-	
-	// Serial to parallel data conversion
-	for (i = 0; i < Parallel; i++)
-	{	for (j = 0; j < loop_count; j++)
-		{	if (i + j * Parallel < kk_shorten)
-				data_p[i][j] = data[i + j * Parallel];
-			else
-				data_p[i][j] = 0;
-		}
-	}
-	
-	// Initialize the parity bits.
-	for (i = 0; i < rr; i++)
-		bb[i] = 0;
-	
-	// Compute parity checks
-	// S(t) = T_G_R [ S(t-1) + M(t) ]
-	// Ref: Parallel CRC, Shieh, 2001
-	for (iii = loop_count - 1; iii >= 0; iii--)
-	{	for (i = 0; i < rr; i++)
-			bb_temp[i] = bb[i] ;
-		for (i = Parallel - 1; i >= 0; i--)
-			bb_temp[rr - Parallel + i] = bb_temp[rr - Parallel + i] ^ data_p[i][iii];
-		
-		for (i = 0; i < rr; i++)
-		{	Temp = 0;
-			for (j = 0; j < rr; j++)
-				Temp = Temp ^ (bb_temp[j] * T_G_R[i][j]);
-			bb[i] = Temp;
-		}
-	}
-	
-}
-
-int main(int argc,  char** argv)
-{	int i ;
-	int Help ;
-	int Input_kk ;				// Input indicator
-	int in_count, in_v, in_codeword;	// Input statistics
-	char in_char;
-	
-	fprintf(stderr, "# Binary BCH encoder.  Use -h for details.\n\n");
-	
-	Verbose = 0;
-	Input_kk = 0;
-	Help = 0;
-	mm = df_m;
-	tt = df_t;
-	Parallel = df_p;
-	for (i = 1; i < argc;i++) 
-	{	if (argv[i][0] == '-') 
-		{	switch (argv[i][1]) 
-			{	case 'm': mm = atoi(argv[++i]);
-					if (mm > mm_max)
-						Help = 1;
-					break;
-				case 't': tt = atoi(argv[++i]);
-					break;
-				case 'p': Parallel = atoi(argv[++i]);
-					break;
-				case 'k': kk_shorten = atoi(argv[++i]);
-					if (kk_shorten % 4 != 0)
-					{	fprintf(stderr, "### k must divide 4.\n\n");
-						Help = 1;
-					}
-					Input_kk = 1;
-					break;
-				case 'v': Verbose = 1;
-					break;
-				default: Help = 1;
-			}
-		}
-		else 
-			Help = 1;
-	}
-	
-	if (Help == 1)
-	{	fprintf(stdout,"# Usage %s:  BCH encoder\n", argv[0]);
-		fprintf(stdout,"    -h:  This help message\n");
-		fprintf(stdout,"    -m <field>:  Galois field, GF, for code.  Code length is 2^<field>-1.\n");
-		fprintf(stdout,"         The default value is %d for a code length %d.  If the parameter is\n", df_m, (int)pow(2,df_m) - 1);
-		fprintf(stdout,"         set to 0, the program will estimate the value based upon the values\n");
-		fprintf(stdout,"         chosen for k and t.\n");
-		fprintf(stdout,"    -t <correct>:  Correction power of the code.  Default = %d\n",df_t);
-		fprintf(stdout,"    -k <data bits>:  Number of data bits to be encoded. Must divide 4.\n");
-		fprintf(stdout,"         The default value is the maximum supported by the code which\n");
-		fprintf(stdout,"         depends upon the field (-m) and the correction (-t) chosen.\n");
-		fprintf(stdout,"    -p <parallel>:  Parallelism in encoder.  Does not effect results but\n");
-		fprintf(stdout,"         does change the algorithm used to generate them.  Default = %d\n", df_p);
-		fprintf(stdout,"    -v   Verbose mode.  Output detailed information, such as encoded codeword,\n");
-		fprintf(stdout,"         received codeword and decoded codeword.  Default disabled. \n");
-		fprintf(stdout,"    <stdin>:  character string to encode in hex format.  All other \n");
-		fprintf(stdout,"          characters are ignored.  Comments are enclosed in brackets:  { }.\n");
-		fprintf(stdout,"          The hex values are converted to binary and taken <data bits> \n");
-		fprintf(stdout,"          at a time.\n");
-		fprintf(stdout,"    <stdout>:  resulting encoded character string in hex format.\n");
-		fprintf(stdout,"    <stderr>:  information about the encode process as well as error messages.\n");
-	}
-	else
-	{	nn = (int)pow(2, mm) - 1 ;
-		nn_shorten = nn ;
-		
-		// generate the Galois Field GF(2**mm)
-		generate_gf() ;
-		
-		// Compute the generator polynomial and lookahead matrix for BCH code
-		gen_poly() ;
-		
-		// Check if code is shortened
-		if (Input_kk == 1)
-			nn_shorten = kk_shorten + rr ;
-		else
-		{	kk_shorten = nn_shorten - rr ;
-			// Make the shortened length divide 4
-			kk_shorten = kk_shorten - kk_shorten % 4 ;
-			nn_shorten = kk_shorten + rr ;
-		}
-		
-		fprintf(stdout, "{# (m = %d, n = %d, k = %d, t = %d, r = %d) Binary BCH code.}\n", mm, nn_shorten, kk_shorten, tt, rr) ;
-		
-		// Read in data stream
-		in_count = 0;
-		in_codeword = 0;
-		
-		in_char = getchar();
-		while (in_char != EOF) 
-		{	if (in_char=='{') 
-			{	while ((in_char != EOF) && ((char)in_char != '}'))
-					in_char = getchar();
-			}
-			in_v = hextoint(in_char);		
-			if (in_v != -1)
-			{	for (i = 3; i >= 0; i--) 
-				{	if ((int)pow(2,i) & in_v)
-						data[in_count] = 1 ;
-					else
-						data[in_count] = 0 ;
-					
-					in_count++;
-				}
-			}
-			if (in_count == kk_shorten) 
-			{	in_codeword++ ;
-				
-				parallel_encode_bch() ;
-				
-				print_hex_low(kk_shorten, data, stdout);
-				fprintf(stdout, "    ");
-				print_hex_low(rr, bb, stdout);
-				fprintf(stdout, "\n") ;
-				
-				in_count = 0;
-			}
-			in_char = getchar();
-		
-			// For last codeword
-			if (in_char == EOF && in_count > 0) 
-			{	in_codeword++ ;
-				// Pad zeros
-				for (i = in_count; i < kk_shorten; i++)
-					data[i] = 0;
-				
-				parallel_encode_bch() ;
-				
-				print_hex_low(kk_shorten, data, stdout);
-				fprintf(stdout, "    ");
-				print_hex_low(rr, bb, stdout);
-				fprintf(stdout, "\n") ;
-				in_count = 0;
-			}
-		}
-		fprintf(stdout, "\n{### %d words encoded.}\n", in_codeword) ;
-	}
-	
-	return(0);
-}
+/*******************************************************************************
+*
+*    File Name:  bch_encoder.c
+*     Revision:  1.0
+*         Date:  August, 2006
+*        Email:  nandsupport@micron.com
+*      Company:  Micron Technology, Inc.
+*
+*  Description:  Micron NAND BCH Encoder
+*
+*   References: 
+* 		  1. Error Control Coding, Lin & Costello, 2nd Ed., 2004
+* 		  2. Error Control Codes, Blahut, 1983
+**
+*   Disclaimer   This software code and all associated documentation, comments or other 
+*  of Warranty:  information (collectively "Software") is provided "AS IS" without 
+*                warranty of any kind. MICRON TECHNOLOGY, INC. ("MTI") EXPRESSLY 
+*                DISCLAIMS ALL WARRANTIES EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED 
+*                TO, NONINFRINGEMENT OF THIRD PARTY RIGHTS, AND ANY IMPLIED WARRANTIES 
+*                OF MERCHANTABILITY OR FITNESS FOR ANY PARTICULAR PURPOSE. MTI DOES NOT 
+*                WARRANT THAT THE SOFTWARE WILL MEET YOUR REQUIREMENTS, OR THAT THE 
+*                OPERATION OF THE SOFTWARE WILL BE UNINTERRUPTED OR ERROR-FREE. 
+*                FURTHERMORE, MTI DOES NOT MAKE ANY REPRESENTATIONS REGARDING THE USE OR 
+*                THE RESULTS OF THE USE OF THE SOFTWARE IN TERMS OF ITS CORRECTNESS, 
+*                ACCURACY, RELIABILITY, OR OTHERWISE. THE ENTIRE RISK ARISING OUT OF USE 
+*                OR PERFORMANCE OF THE SOFTWARE REMAINS WITH YOU. IN NO EVENT SHALL MTI, 
+*                ITS AFFILIATED COMPANIES OR THEIR SUPPLIERS BE LIABLE FOR ANY DIRECT, 
+*                INDIRECT, CONSEQUENTIAL, INCIDENTAL, OR SPECIAL DAMAGES (INCLUDING, 
+*                WITHOUT LIMITATION, DAMAGES FOR LOSS OF PROFITS, BUSINESS INTERRUPTION, 
+*                OR LOSS OF INFORMATION) ARISING OUT OF YOUR USE OF OR INABILITY TO USE 
+*                THE SOFTWARE, EVEN IF MTI HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH 
+*                DAMAGES. Because some jurisdictions prohibit the exclusion or 
+*                limitation of liability for consequential or incidental damages, the 
+*                above limitation may not apply to you.
+*
+*                Copyright 2006 Micron Technology, Inc. All rights reserved.
+*
+* Rev  Author			Date		Changes
+* ---  ---------------	----------	-------------------------------
+* 1.0  ZS		08/07/2006	Initial release
+* 
+* 
+/*******************************************************************************/
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bch.h"
+
+#define batch_max  64			// Codewords encoded per bch_encode_batch() call
+
+void encode_codewords(const bch_ctx *ctx, bch_work *work, int n, unsigned char *data_packed, unsigned char *parity_packed)
+{	int i, data_bytes, parity_bytes ;
+	
+	data_bytes = (ctx->kk_shorten + 7) / 8 ;
+	parity_bytes = (ctx->rr + 7) / 8 ;
+	bch_encode_batch(ctx, work, data_packed, data_bytes, n, parity_packed, parity_bytes) ;
+	
+	for (i = 0; i < n; i++)
+	{	print_hex_bytes(0, ctx->kk_shorten, data_packed + i * data_bytes, stdout);
+		fprintf(stdout, "    ");
+		print_hex_bytes(0, ctx->rr, parity_packed + i * parity_bytes, stdout);
+		fprintf(stdout, "\n") ;
+	}
+}
+
+#define binary_batch  1024		// Records per read in --binary mode
+
+int encode_binary(const bch_ctx *ctx, bch_work *work)
+/* Encode raw data records of k / 8 bytes from stdin, writing each followed
+ * by its parity bytes to stdout.  A partial last record is padded with zeros.
+ * Returns the number of codewords, or -1 if out of memory.
+ */
+{	int i, n, words, data_bytes, parity_bytes ;
+	bin_input *in ;
+	unsigned char *data, *parity, *out, *last ;
+	
+	data_bytes = ctx->kk_shorten / 8 ;
+	parity_bytes = (ctx->rr + 7) / 8 ;
+	in = bin_open(0, data_bytes, binary_batch) ;
+	parity = malloc((size_t)binary_batch * parity_bytes) ;
+	out = malloc((size_t)binary_batch * (data_bytes + parity_bytes)) ;
+	if (in == NULL || parity == NULL || out == NULL)
+		return -1 ;
+	
+	words = 0 ;
+	while ((data = bin_read(in, &n)), n > 0)
+	{	bch_encode_batch(ctx, work, data, data_bytes, n, parity, parity_bytes) ;
+		for (i = 0; i < n; i++)
+		{	memcpy(out + (size_t)i * (data_bytes + parity_bytes), data + (size_t)i * data_bytes, data_bytes) ;
+			memcpy(out + (size_t)i * (data_bytes + parity_bytes) + data_bytes, parity + (size_t)i * parity_bytes, parity_bytes) ;
+		}
+		fwrite(out, data_bytes + parity_bytes, n, stdout) ;
+		words += n ;
+	}
+	if (in->tail_len > 0)
+	{	// Pad zeros
+		last = out ;
+		memset(last, 0, data_bytes) ;
+		memcpy(last, in->tail, in->tail_len) ;
+		bch_encode_batch(ctx, work, last, data_bytes, 1, last + data_bytes, parity_bytes) ;
+		fwrite(last, data_bytes + parity_bytes, 1, stdout) ;
+		words++ ;
+	}
+	
+	bin_close(in) ;
+	free(parity) ;
+	free(out) ;
+	return words ;
+}
+
+void fill_page(const bch_page_layout *layout, int data_bytes, const unsigned char *data, size_t len, unsigned char *page)
+/* Erased page holding the sector data of len bytes, padded with zeros */
+{	size_t i, n ;
+	
+	memset(page, 0xff, layout->page_bytes) ;
+	for (i = 0; i < (size_t)layout->sectors; i++)
+	{	n = len > i * data_bytes ? len - i * data_bytes : 0 ;
+		n = n < (size_t)data_bytes ? n : (size_t)data_bytes ;
+		memcpy(page + layout->data_offset + i * layout->data_stride, data + i * data_bytes, n) ;
+		memset(page + layout->data_offset + i * layout->data_stride + n, 0, data_bytes - n) ;
+	}
+}
+
+int encode_pages(const bch_ctx *ctx, const bch_page_layout *layout)
+/* Encode raw pages (--page):  the data of every sector of a page, sectors *
+ * k / 8 bytes, from stdin, written to stdout as the whole page with the
+ * parity in its layout.  Spare bytes holding no parity are 0xff, as erased
+ * flash.  A partial last page is padded with zeros.  Returns the number of
+ * pages, or -1 if out of memory.
+ */
+{	int p, n, batch, pages, data_bytes, page_data ;
+	bin_input *in ;
+	bch_page *pg ;
+	unsigned char *data, *out ;
+	
+	data_bytes = ctx->kk_shorten / 8 ;
+	page_data = layout->sectors * data_bytes ;
+	batch = binary_batch / layout->sectors + 1 ;
+	in = bin_open(0, page_data, batch) ;
+	pg = bch_page_new(ctx, layout, batch, NULL) ;
+	out = malloc((size_t)batch * layout->page_bytes) ;
+	if (in == NULL || pg == NULL || out == NULL)
+		return -1 ;
+	
+	pages = 0 ;
+	while ((data = bin_read(in, &n)), n > 0)
+	{	for (p = 0; p < n; p++)
+			fill_page(layout, data_bytes, data + (size_t)p * page_data, page_data, out + (size_t)p * layout->page_bytes) ;
+		bch_page_encode(pg, out, n) ;
+		fwrite(out, layout->page_bytes, n, stdout) ;
+		pages += n ;
+	}
+	if (in->tail_len > 0)
+	{	fill_page(layout, data_bytes, in->tail, in->tail_len, out) ;
+		bch_page_encode(pg, out, 1) ;
+		fwrite(out, layout->page_bytes, 1, stdout) ;
+		pages++ ;
+	}
+	
+	bin_close(in) ;
+	bch_page_free(pg) ;
+	free(out) ;
+	return pages ;
+}
+
+int main(int argc,  char** argv)
+{	int i ;
+	int Help ;
+	int Input_kk ;				// Input indicator
+	int mm, tt, kk_shorten, nn_shorten, rr, Parallel ;	// BCH code parameters
+	int flags ;				// bch_init() options
+	int Binary ;				// Raw binary input and output
+	int Sectors, Spare_offset, Interleaved ;	// NAND page layout (--page)
+	bch_page_layout layout ;
+	bch_ctx *ctx ;				// Code context
+	bch_work *work ;			// Encoder scratch state
+	unsigned char *data_packed ;		// Information data of a batch, MSB first
+	unsigned char *parity_packed ;		// Parity checks of a batch, MSB first
+	unsigned char *data_in ;		// Codeword being read
+	int batch, data_bytes ;			// Codewords in the batch, bytes per codeword
+	hex_input *in ;				// Hex text on stdin
+	int in_count, in_codeword;		// Input statistics
+	
+	fprintf(stderr, "# Binary BCH encoder.  Use -h for details.\n\n");
+	
+	flags = BCH_CACHE;
+	Input_kk = 0;
+	kk_shorten = 0;
+	Binary = 0;
+	Sectors = 0;
+	Spare_offset = 0;
+	Interleaved = 0;
+	Help = 0;
+	mm = df_m;
+	tt = df_t;
+	Parallel = df_p;
+	for (i = 1; i < argc;i++) 
+	{	if (argv[i][0] == '-') 
+		{	switch (argv[i][1]) 
+			{	case 'm': mm = atoi(argv[++i]);
+					if (mm > mm_max)
+						Help = 1;
+					break;
+				case 't': tt = atoi(argv[++i]);
+					break;
+				case 'p': Parallel = atoi(argv[++i]);
+					break;
+				case 'k': kk_shorten = atoi(argv[++i]);
+					if (kk_shorten % 4 != 0)
+					{	fprintf(stderr, "### k must divide 4.\n\n");
+						Help = 1;
+					}
+					Input_kk = 1;
+					break;
+				case 'v': flags |= BCH_VERBOSE;
+					break;
+				case 'l': flags |= BCH_LOOKAHEAD;
+					break;
+				case '-': if (strcmp(argv[i], "--binary") == 0)
+						Binary = 1;
+					else if (strcmp(argv[i], "--page") == 0 && i + 1 < argc)
+					{	Sectors = atoi(argv[++i]);
+						Binary = 1;
+						if (Sectors < 1)
+							Help = 1;
+					}
+					else if (strcmp(argv[i], "--spare-offset") == 0 && i + 1 < argc)
+					{	Spare_offset = atoi(argv[++i]);
+						if (Spare_offset < 0)
+							Help = 1;
+					}
+					else if (strcmp(argv[i], "--interleaved") == 0)
+						Interleaved = 1;
+					else
+						Help = 1;
+					break;
+				default: Help = 1;
+			}
+		}
+		else 
+			Help = 1;
+	}
+	
+	if (Help == 1)
+	{	fprintf(stdout,"# Usage %s:  BCH encoder\n", argv[0]);
+		fprintf(stdout,"    -h:  This help message\n");
+		fprintf(stdout,"    -m <field>:  Galois field, GF, for code.  Code length is 2^<field>-1.\n");
+		fprintf(stdout,"         The default value is %d for a code length %d.  If the parameter is\n", df_m, (int)pow(2,df_m) - 1);
+		fprintf(stdout,"         set to 0, the program will estimate the value based upon the values\n");
+		fprintf(stdout,"         chosen for k and t.\n");
+		fprintf(stdout,"    -t <correct>:  Correction power of the code.  Default = %d\n",df_t);
+		fprintf(stdout,"    -k <data bits>:  Number of data bits to be encoded. Must divide 4.\n");
+		fprintf(stdout,"         The default value is the maximum supported by the code which\n");
+		fprintf(stdout,"         depends upon the field (-m) and the correction (-t) chosen.\n");
+		fprintf(stdout,"    -p <parallel>:  Parallelism in encoder.  Does not effect results but\n");
+		fprintf(stdout,"         does change the algorithm used to generate them.  Default = %d\n", df_p);
+		fprintf(stdout,"         Only used by the lookahead encoder (-l); the default table driven\n");
+		fprintf(stdout,"         encoder always consumes 64 bits per step.\n");
+		fprintf(stdout,"    -l   Use the bit-serial lookahead matrix encoder.  Default disabled. \n");
+		fprintf(stdout,"    -v   Verbose mode.  Output detailed information, such as encoded codeword,\n");
+		fprintf(stdout,"         received codeword and decoded codeword.  Default disabled. \n");
+		fprintf(stdout,"    --binary:  Raw binary input and output.  <stdin> holds <data bits> / 8\n");
+		fprintf(stdout,"         bytes per codeword and is memory mapped when it is a file; each\n");
+		fprintf(stdout,"         is written to <stdout> followed by its parity, (<r> + 7) / 8 bytes.\n");
+		fprintf(stdout,"         <data bits> must divide 8.  Default disabled. \n");
+		fprintf(stdout,"    --page <sectors>:  Raw NAND pages of <sectors> codewords, --binary\n");
+		fprintf(stdout,"         implied.  <stdin> holds the data of every sector of a page and\n");
+		fprintf(stdout,"         each page is written with its parity.  By default the sectors\n");
+		fprintf(stdout,"         fill the main area and their parity follows in the spare area;\n");
+		fprintf(stdout,"         spare bytes holding no parity are 0xff.  Default disabled. \n");
+		fprintf(stdout,"    --spare-offset <bytes>:  Bytes at the start of the spare area before\n");
+		fprintf(stdout,"         the parity, such as the bad block marker.  Default = 0\n");
+		fprintf(stdout,"    --interleaved:  Each sector is followed by its parity in the page.\n");
+		fprintf(stdout,"         Default disabled. \n");
+		fprintf(stdout,"    The code tables are cached in $BCH_CACHE_DIR (default ~/.cache/bch) for\n");
+		fprintf(stdout,"    the next run; set it empty to disable the cache.\n");
+		fprintf(stdout,"    <stdin>:  character string to encode in hex format.  All other \n");
+		fprintf(stdout,"          characters are ignored.  Comments are enclosed in brackets:  { }.\n");
+		fprintf(stdout,"          The hex values are converted to binary and taken <data bits> \n");
+		fprintf(stdout,"          at a time.\n");
+		fprintf(stdout,"    <stdout>:  resulting encoded character string in hex format.\n");
+		fprintf(stdout,"    <stderr>:  information about the encode process as well as error messages.\n");
+	}
+	else
+	{	// Galois field, generator polynomial and encoder tables
+		ctx = bch_init(mm, tt, Input_kk ? kk_shorten : 0, Parallel, flags, "scalar") ;
+		if (ctx == NULL)
+		{	fprintf(stderr, "### Unsupported code:  m = %d, t = %d, k = %d.\n\n", mm, tt, kk_shorten) ;
+			return(1);
+		}
+		work = bch_work_new(ctx) ;
+		kk_shorten = ctx->kk_shorten ;
+		nn_shorten = ctx->nn_shorten ;
+		rr = ctx->rr ;
+		
+		if (Binary)
+		{	if (kk_shorten % 8 != 0)
+			{	fprintf(stderr, "### k must divide 8 with --binary.\n\n") ;
+				return(1);
+			}
+			fprintf(stderr, "{# (m = %d, n = %d, k = %d, t = %d, r = %d) Binary BCH code.}\n", mm, nn_shorten, kk_shorten, tt, rr) ;
+			if (Sectors)
+			{	if (Interleaved)
+					bch_page_layout_interleaved(ctx, &layout, Sectors) ;
+				else
+					bch_page_layout_spare(ctx, &layout, Sectors, Spare_offset) ;
+				fprintf(stderr, "{# %d sectors in a page of %d bytes.}\n", Sectors, layout.page_bytes) ;
+				in_codeword = encode_pages(ctx, &layout) ;
+			}
+			else
+				in_codeword = work ? encode_binary(ctx, work) : -1 ;
+			if (in_codeword < 0)
+			{	fprintf(stderr, "### Out of memory.\n\n") ;
+				return(1);
+			}
+			fprintf(stderr, Sectors ? "{### %d pages encoded.}\n" : "{### %d words encoded.}\n", in_codeword) ;
+			bch_work_free(work) ;
+			bch_free(ctx) ;
+			return(0);
+		}
+		
+		data_bytes = (kk_shorten + 7) / 8 ;
+		data_packed = malloc(batch_max * data_bytes) ;
+		parity_packed = malloc(batch_max * ((rr + 7) / 8)) ;
+		in = hex_open(0) ;
+		if (work == NULL || data_packed == NULL || parity_packed == NULL || in == NULL)
+		{	fprintf(stderr, "### Out of memory.\n\n") ;
+			return(1);
+		}
+		
+		fprintf(stdout, "{# (m = %d, n = %d, k = %d, t = %d, r = %d) Binary BCH code.}\n", mm, nn_shorten, kk_shorten, tt, rr) ;
+		
+		// Read in data stream
+		in_count = 0;
+		in_codeword = 0;
+		batch = 0;
+		data_in = data_packed;
+		
+		while ((in_count = 4 * hex_read(in, data_in, kk_shorten / 4, 0)) > 0)
+		{	in_codeword++ ;
+			
+			// For last codeword
+			if (in_count < kk_shorten)
+			{	// Pad zeros
+				memset(data_in + (in_count + 7) / 8, 0, data_bytes - (in_count + 7) / 8) ;
+				batch++ ;
+				break ;
+			}
+			
+			if (++batch == batch_max)
+			{	encode_codewords(ctx, work, batch, data_packed, parity_packed) ;
+				batch = 0;
+			}
+			data_in = data_packed + batch * data_bytes;
+		}
+		if (batch > 0)
+			encode_codewords(ctx, work, batch, data_packed, parity_packed) ;
+		fprintf(stdout, "\n{### %d words encoded.}\n", in_codeword) ;
+		
+		hex_close(in) ;
+		free(data_packed) ;
+		free(parity_packed) ;
+		bch_work_free(work) ;
+		bch_free(ctx) ;
+	}
+	
+	return(0);
+}
@@ -0,0 +1,127 @@
+/*******************************************************************************
+*
+*    File Name:  bch_fixed.c
+*
+*  Description:  libbch codecs specialised at compile time to fixed (m, t, k)
+*
+*     Function:   1. BCH_FIXED(m, t, k, r) instantiates the table driven
+*		     remainder, the syndrome polynomial and the scalar odd
+*		     syndromes of one code, with every loop bound and buffer a
+*		     constant so the compiler unrolls the register words and
+*		     keeps the remainder in registers.
+*		  2. bch_fixed_find() looks the code of a context up in the
+*		     registry; bch_init() binds the match, and the generic code
+*		     runs for every other code.
+*
+*		  The tables themselves (alpha_to, index_of, the remainder
+*		  tables) still come from the code context, built at startup
+*		  or mapped from the cache (BCH_CACHE), so a specialisation
+*		  adds code but no data.  k must divide 8 so data and parity
+*		  are byte aligned.
+*
+*		  To add a code, add a BCH_FIXED() line and its registry
+*		  entry; r is checked against gen_poly() before it is bound.
+*
+*******************************************************************************/
+
+#include <string.h>
+#include "bch.h"
+
+#define fixed_inline  static inline __attribute__((always_inline))
+
+fixed_inline void fixed_remainder(const uint64_t *rem_table, const unsigned char *data, uint64_t *rem,
+				  const int length, const int rem_words)
+/* packed_remainder() of length bytes, length and rem_words constant */
+{	unsigned char head[slice_max] ;
+	int n, w ;
+
+	for (w = 0; w < rem_words; w++)
+		rem[w] = 0 ;
+	n = length - length % slice_max ;
+	if (n != length)
+	{	memset(head, 0, slice_max) ;
+		memcpy(head, data + n, length - n) ;
+		remainder_step(rem_table, rem_words, rem, load_be64(head)) ;
+	}
+	while (n > 0)
+	{	n -= slice_max ;
+		remainder_step(rem_table, rem_words, rem, load_be64(data + n)) ;
+	}
+}
+
+fixed_inline int fixed_syndrome(const bch_ctx *ctx, bch_work *w, const unsigned char *codeword,
+				const int kk, const int rr)
+/* S(x) = [ x**rr d(x) mod g(x) ] + b(x) into w->bb, or 0 if it is zero, as
+ * packed_syndrome()
+ */
+{	uint64_t rem[(rr + 63) / 64] ;
+	int i ;
+
+	fixed_remainder(ctx->rem_table, codeword, rem, kk / 8, (rr + 63) / 64) ;
+	for (i = 0; i < rr / 8; i++)
+		remainder_xor_byte(ctx, rem, i, codeword[kk / 8 + i]) ;
+	if (rr % 8)
+		remainder_xor_byte(ctx, rem, i, codeword[kk / 8 + i] & (0xff << (8 - rr % 8))) ;
+	if (remainder_zero(rem, (rr + 63) / 64))
+		return 0 ;
+	for (i = 0; i < rr; i++)
+		w->bb[i] = (rem[(rr - 1 - i) >> 6] >> ((rr - 1 - i) & 63)) & 1 ;
+	return 1 ;
+}
+
+fixed_inline void fixed_odd_syndromes(const bch_ctx *ctx, bch_work *w, const int nn, const int tt, const int rr)
+/* S(i) = S(alpha**i), i odd, as remainder_syndromes().  S(x) is binary, so
+ * the sum runs over the set bits only, with the exponent stepped by i.
+ */
+{	const int *alpha_to = ctx->alpha_to ;
+	int i, j, e, v ;
+
+	for (i = 1; i <= 2 * tt - 1; i += 2)
+	{	v = 0 ;
+		e = 0 ;
+		for (j = 0; j < rr; j++)
+		{	if (w->bb[j])
+				v ^= alpha_to[e] ;
+			e += i ;
+			if (e >= nn)
+				e -= nn ;
+		}
+		w->s[i] = v ;
+	}
+}
+
+#define BCH_FIXED(m, t, k, r) \
+static void remainder_##m##_##t##_##k(const bch_ctx *ctx, const unsigned char *data, uint64_t *rem) \
+{	fixed_remainder(ctx->rem_table, data, rem, (k) / 8, ((r) + 63) / 64) ; \
+} \
+static int syndrome_##m##_##t##_##k(const bch_ctx *ctx, bch_work *w, const unsigned char *codeword) \
+{	return fixed_syndrome(ctx, w, codeword, k, r) ; \
+} \
+static void odd_syndromes_##m##_##t##_##k(const bch_ctx *ctx, bch_work *w) \
+{	fixed_odd_syndromes(ctx, w, (1 << (m)) - 1, t, r) ; \
+}
+
+#define fixed_entry(m, t, k, r) \
+	{ m, t, k, r, remainder_##m##_##t##_##k, syndrome_##m##_##t##_##k, odd_syndromes_##m##_##t##_##k }
+
+// Production codes over 512 byte and 2 KB sectors
+BCH_FIXED(13, 8, 4096, 104)
+BCH_FIXED(13, 4, 4096, 52)
+BCH_FIXED(15, 16, 16384, 240)
+
+static const bch_fixed fixed_codecs[] = {
+	fixed_entry(13, 8, 4096, 104),
+	fixed_entry(13, 4, 4096, 52),
+	fixed_entry(15, 16, 16384, 240),
+} ;
+
+const bch_fixed *bch_fixed_find(const bch_ctx *ctx)
+/* Specialisation of the code of ctx, or NULL if there is none */
+{	int i ;
+
+	for (i = 0; i < (int)(sizeof(fixed_codecs) / sizeof(fixed_codecs[0])); i++)
+		if (fixed_codecs[i].mm == ctx->mm && fixed_codecs[i].tt == ctx->tt
+		 && fixed_codecs[i].kk == ctx->kk_shorten && fixed_codecs[i].rr == ctx->rr)
+			return &fixed_codecs[i] ;
+	return NULL ;
+}
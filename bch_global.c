@@ -1,304 +1,719 @@
-/*******************************************************************************
-*
-*    File Name:  bch_global.c
-*     Revision:  1.0
-*         Date:  August, 2006
-*        Email:  nandsupport@micron.com
-*      Company:  Micron Technology, Inc.
-*
-*  Description:  Micron NAND BCH Global Package
-*
-*     Function:   1. Create Galois Field
-*		  2. Create Generator Polynomial
-*		  3. Create Parallel Generator Polynomial 
-*
-*   References: 
-* 		  1. Error Control Coding, Lin & Costello, 2nd Ed., 2004
-* 		  2. Error Control Codes, Blahut, 1983
-* 		  3. Parallel CRC, Shieh, 2001
-*
-**
-*   Disclaimer   This software code and all associated documentation, comments or other 
-*  of Warranty:  information (collectively "Software") is provided "AS IS" without 
-*                warranty of any kind. MICRON TECHNOLOGY, INC. ("MTI") EXPRESSLY 
-*                DISCLAIMS ALL WARRANTIES EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED 
-*                TO, NONINFRINGEMENT OF THIRD PARTY RIGHTS, AND ANY IMPLIED WARRANTIES 
-*                OF MERCHANTABILITY OR FITNESS FOR ANY PARTICULAR PURPOSE. MTI DOES NOT 
-*                WARRANT THAT THE SOFTWARE WILL MEET YOUR REQUIREMENTS, OR THAT THE 
-*                OPERATION OF THE SOFTWARE WILL BE UNINTERRUPTED OR ERROR-FREE. 
-*                FURTHERMORE, MTI DOES NOT MAKE ANY REPRESENTATIONS REGARDING THE USE OR 
-*                THE RESULTS OF THE USE OF THE SOFTWARE IN TERMS OF ITS CORRECTNESS, 
-*                ACCURACY, RELIABILITY, OR OTHERWISE. THE ENTIRE RISK ARISING OUT OF USE 
-*                OR PERFORMANCE OF THE SOFTWARE REMAINS WITH YOU. IN NO EVENT SHALL MTI, 
-*                ITS AFFILIATED COMPANIES OR THEIR SUPPLIERS BE LIABLE FOR ANY DIRECT, 
-*                INDIRECT, CONSEQUENTIAL, INCIDENTAL, OR SPECIAL DAMAGES (INCLUDING, 
-*                WITHOUT LIMITATION, DAMAGES FOR LOSS OF PROFITS, BUSINESS INTERRUPTION, 
-*                OR LOSS OF INFORMATION) ARISING OUT OF YOUR USE OF OR INABILITY TO USE 
-*                THE SOFTWARE, EVEN IF MTI HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH 
-*                DAMAGES. Because some jurisdictions prohibit the exclusion or 
-*                limitation of liability for consequential or incidental damages, the 
-*                above limitation may not apply to you.
-*
-*                Copyright 2006 Micron Technology, Inc. All rights reserved.
-*
-*
-* Rev  Author		Date		Changes
-* ---  ---------------	----------	-------------------------------
-* 1.0  ZS		08/07/2006	Initial release
-* 2.0  PF		03/05/2007	Expanded constants to allow 
-* 					larger fields
-* 
-* 
-/*******************************************************************************/
-
-#include <math.h>
-#include <stdio.h>
-#include <stdlib.h>
-
-#define mm_max  15         	/* Dimension of Galoise Field */
-#define nn_max  32768        	/* Length of codeword, n = 2**m - 1 */
-#define tt_max  20          	/* Number of errors that can be corrected */
-#define kk_max  32768        	/* Length of information bit, kk = nn - rr  */
-#define rr_max  1000		/* Number of parity checks, rr = deg[g(x)] */
-#define parallel_max  32	/* Number of parallel encoding/syndrome computations */
-#define DEBUG  0
-
-/* Default values */
-int df_m = 13;              	// BCH code over GF(2**mm)
-int df_t = 4;              	// Number of errors that can be corrected
-int df_p = 8;              	// Number of substreams to calculate in parallel
-
-int mm, nn, kk, tt, rr;		// BCH code parameters
-int nn_shorten, kk_shorten;	// Shortened BCH code
-int Parallel ;			// Parallel processing
-int Verbose ;			// Mode indicator
-int p[mm_max + 1], alpha_to[nn_max], index_of[nn_max] ;	// Galois field
-int gg[rr_max] ;		// Generator polynomial
-int T_G[rr_max][rr_max], T_G_R[rr_max][rr_max];		// Parallel lookahead table
-int T_G_R_Temp[rr_max][rr_max] ; 
-int data[kk_max], data_p[parallel_max][kk_max], recd[nn_max] ;	// Information data and received data
-
-int hextoint(char hex)
-// Convert HEX number to Integer
-{	int r, h;
-	r = -1;
-	h = (int)hex;
-	if ((h >= 97) && (h <= 102)) 
-		r = h - 87;
-	else if ((h >= 65) && (h <= 70)) 
-		r = h - 55;
-	else if ((h >= 48) && (h <= 57)) 
-		r = h - 48;
-	return r;
-}
-
-char inttohex(int i)
-// Convert Integer number to HEX
-{	char r;
-	if (i > 9)
-		r = (char)(55 + i);
-	else
-		r = (char)(48 + i);
-	return r;
-}
-
-void print_hex(int length, int Binary_data[length], FILE *std)
-// Print the binary data in HEX form
-// 1100 1010 = 5 3
-{	int i, j, l, v;
-	l = ceil((double)length / 4);
-	
-	for (j = l - 1; j >= 0; j--) 
-	{	v = 0;
-		for(i = 3; i >= 0; i--)
-			v = v + (int)Binary_data[j * 4 + i] * (int)pow(2, i);
-		fprintf(std, " %c", inttohex(v));
-	}
-}
-
-void print_hex_low(int length, int Binary_data[length], FILE *std)
-// Print the binary data in HEX form from low to high order
-// 1100 1010 = C A
-{	int i, j, l, v;
-	l = ceil((double)length / 4);
-	
-	for (j = 0; j < l; j++) 
-	{	v = 0;
-		for(i = 0; i <= 3; i++)
-			v = v + (int)Binary_data[j * 4 + i] * (int)pow(2, 3-i);
-		fprintf(std, "%c", inttohex(v));
-	}
-}
-
-void generate_gf()
-/* Generate GF(2**mm) from the primitive polynomial p(X) in p[0]..p[mm]
-   The lookup table looks like:  
-   index -> polynomial form:   alpha_to[ ] contains j = alpha**i;
-   polynomial form -> index form:  index_of[j = alpha**i] = i
-   alpha_to[1] = 2 is the primitive element of GF(2**mm)
- */
-{	int i;
-	int mask ;	// Register states
-	
-	// Primitive polynomials
-   	for (i = 1; i < mm; i++)
-		p[i] = 0;
-	p[0] = p[mm] = 1;
-	if (mm == 2)		p[1] = 1;
-	else if (mm == 3)	p[1] = 1;
-	else if (mm == 4)	p[1] = 1;
-	else if (mm == 5)	p[2] = 1;
-	else if (mm == 6)	p[1] = 1;
-	else if (mm == 7)	p[1] = 1;
-	else if (mm == 8)	p[4] = p[5] = p[6] = 1;
-	else if (mm == 9)	p[4] = 1;
-	else if (mm == 10)	p[3] = 1;
-	else if (mm == 11)	p[2] = 1;
-	else if (mm == 12)	p[3] = p[4] = p[7] = 1;
-	else if (mm == 13)	p[1] = p[2] = p[3] = p[5] = p[7] = p[8] = p[10] = 1;	// 25AF
-	// else if (mm == 13)	p[1] = p[3] = p[4] = 1;
-	else if (mm == 14)	p[2] = p[4] = p[6] = p[7] = p[8] = 1;	// 41D5
-	// else if (mm == 14)	p[1] = p[11] = p[12] = 1;
-	else if (mm == 15)	p[1] = 1;
-	else if (mm == 16)	p[2] = p[3] = p[5] = 1;
-	else if (mm == 17)	p[3] = 1;
-	else if (mm == 18)	p[7] = 1;
-	else if (mm == 19)	p[1] = p[5] = p[6] = 1;
-	else if (mm == 20)	p[3] = 1;
-	
-	if (Verbose)
-	{	fprintf(stderr, "# The Galois field is GF(2**%d);\n\n", mm);
-		fprintf(stderr, "# The primitive polynomial is: p(x) = ");
-		for (i = 0; i <= mm; i++) 
-		{	fprintf(stderr, " %d", p[i]);
-		}
-		fprintf(stderr, "\n\n");
-	}
-	
-	// Galois field implementation with shift registers
-	// Ref: L&C, Chapter 6.7, pp. 217
-	mask = 1 ;
-	alpha_to[mm] = 0 ;
-	for (i = 0; i < mm; i++)
-	{ 	alpha_to[i] = mask ;
-		index_of[alpha_to[i]] = i ;
-		if (p[i] != 0)
-			alpha_to[mm] ^= mask ;
-		
-		mask <<= 1 ;
-	}
-	
-	index_of[alpha_to[mm]] = mm ;
-	mask >>= 1 ;
-	for (i = mm + 1; i < nn; i++)
-	{ 	if (alpha_to[i-1] >= mask)
-			alpha_to[i] = alpha_to[mm] ^ ((alpha_to[i-1] ^ mask) << 1) ;
-		else alpha_to[i] = alpha_to[i-1] << 1 ;
-		
-		index_of[alpha_to[i]] = i ;
-	}
-	index_of[0] = -1 ;
-	
-	// Print out the Galois Field
-	if (Verbose)
-	{	fprintf(stderr, "# Look-up tables for GF(2**%2d)\n", mm) ;
-		fprintf(stderr, "  i   alpha_to[i]  index_of[i]\n") ;
-		for (i=0; i<=nn; i++)
-			fprintf(stderr, "%3d      %3d          %3d\n", i, alpha_to[i], index_of[i]) ;
-		fprintf(stderr, "\n") ;
-	}
-}
-
-
-void gen_poly()
-/* Compute generator polynomial of the tt-error correcting Binary BCH code 
- * g(x) = LCM{M_1(x), M_2(x), ..., M_2t(x)},
- * where M_i(x) is the minimal polynomial of alpha^i by cyclotomic cosets
- */
-{	int gen_roots[nn + 1], gen_roots_true[nn + 1] ; 	// Roots of generator polynomial
-	int i, j, iii, jjj, Temp ;
-		
-	// Initialization of gen_roots
-	for (i = 0; i <= nn; i++) 
-	{	gen_roots_true[i] = 0;
-		gen_roots[i] = 0;
-	}
-
-	// Cyclotomic cosets of gen_roots
-   	for (i = 1; i <= 2*tt ; i++)
-	{	for (j = 0; j < mm; j++) 
-		{	Temp = ((int)pow(2, j) * i) % nn;
-			gen_roots_true[Temp] = 1;
-		}
-	}
-	
-   	rr = 0;		// Count the number of parity check bits
-   	for (i = 0; i < nn; i++) 
-	{	if (gen_roots_true[i] == 1) 
-		{	rr++;
-			gen_roots[rr] = i;
-		}
-	}
-	kk = nn - rr;
-	
-	// Compute generator polynomial based on its roots
-	gg[0] = 2 ;	// g(x) = (X + alpha) initially
-	gg[1] = 1 ;
-	for (i = 2; i <= rr; i++)
-	{ 	gg[i] = 1 ;
-		for (j = i - 1; j > 0; j--)
-		if (gg[j] != 0)  
-			gg[j] = gg[j-1]^ alpha_to[(index_of[gg[j]] + index_of[alpha_to[gen_roots[i]]]) % nn] ;
-		else 
-			gg[j] = gg[j-1] ;
-		gg[0] = alpha_to[(index_of[gg[0]] + index_of[alpha_to[gen_roots[i]]]) % nn] ;
-	}
-	
-	if (Verbose)
-	{	fprintf(stderr, "# The Generator Polynomial is:\n") ;
-		for (i=0; i <= rr; i++)  
-			fprintf(stderr, " %d", gg[i]) ;
-		fprintf(stderr, "\n\n") ;
-	}
-	
-	// for parallel encoding and syndrome computation
-	// Max parallalism is rr
-	if (Parallel > rr)
-		Parallel = rr ;
-	
-	// Construct parallel lookahead matrix T_g, and T_g**r from gg(x)
-	// Ref: Parallel CRC, Shieh, 2001
-	for (i = 0; i < rr; i++)
-	{	for (j = 0; j < rr; j++)
-			T_G[i][j] = 0;
-	}
-	
-	for (i = 1; i < rr; i++)
-		T_G[i][i-1] = 1 ;
-
-	for (i = 0; i < rr; i++)
-		T_G[i][rr - 1] = gg[i] ;
-	
-	for (i = 0; i < rr; i++)
-	{	for (j = 0; j < rr; j++)
-			T_G_R[i][j] = T_G[i][j];
-	}
-	
-	// Compute T_G**R Matrix
-	for (iii = 1; iii < Parallel; iii++)
-	{	for (i = 0; i < rr; i++)
-		{	for (j = 0; j < rr; j++)
-			{	Temp = 0;
-				for (jjj = 0; jjj < rr; jjj++)
-					Temp = Temp ^ T_G_R[i][jjj] * T_G[jjj][j];
-				
-				T_G_R_Temp[i][j] = Temp;
-			}
-		}
-		
-		for (i = 0; i < rr; i++)
-		{	for (j = 0; j < rr; j++)
-				T_G_R[i][j] = T_G_R_Temp[i][j];
-		}
-	}
-}
+/*******************************************************************************
+*
+*    File Name:  bch_global.c
+*     Revision:  1.0
+*         Date:  August, 2006
+*        Email:  nandsupport@micron.com
+*      Company:  Micron Technology, Inc.
+*
+*  Description:  Micron NAND BCH Global Package
+*
+*     Function:   1. Create Galois Field
+*		  2. Create Generator Polynomial
+*		  3. Create Parallel Generator Polynomial 
+*		  4. Create and free the libbch code context (bch.h)
+*
+*   References: 
+* 		  1. Error Control Coding, Lin & Costello, 2nd Ed., 2004
+* 		  2. Error Control Codes, Blahut, 1983
+* 		  3. Parallel CRC, Shieh, 2001
+*
+**
+*   Disclaimer   This software code and all associated documentation, comments or other 
+*  of Warranty:  information (collectively "Software") is provided "AS IS" without 
+*                warranty of any kind. MICRON TECHNOLOGY, INC. ("MTI") EXPRESSLY 
+*                DISCLAIMS ALL WARRANTIES EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED 
+*                TO, NONINFRINGEMENT OF THIRD PARTY RIGHTS, AND ANY IMPLIED WARRANTIES 
+*                OF MERCHANTABILITY OR FITNESS FOR ANY PARTICULAR PURPOSE. MTI DOES NOT 
+*                WARRANT THAT THE SOFTWARE WILL MEET YOUR REQUIREMENTS, OR THAT THE 
+*                OPERATION OF THE SOFTWARE WILL BE UNINTERRUPTED OR ERROR-FREE. 
+*                FURTHERMORE, MTI DOES NOT MAKE ANY REPRESENTATIONS REGARDING THE USE OR 
+*                THE RESULTS OF THE USE OF THE SOFTWARE IN TERMS OF ITS CORRECTNESS, 
+*                ACCURACY, RELIABILITY, OR OTHERWISE. THE ENTIRE RISK ARISING OUT OF USE 
+*                OR PERFORMANCE OF THE SOFTWARE REMAINS WITH YOU. IN NO EVENT SHALL MTI, 
+*                ITS AFFILIATED COMPANIES OR THEIR SUPPLIERS BE LIABLE FOR ANY DIRECT, 
+*                INDIRECT, CONSEQUENTIAL, INCIDENTAL, OR SPECIAL DAMAGES (INCLUDING, 
+*                WITHOUT LIMITATION, DAMAGES FOR LOSS OF PROFITS, BUSINESS INTERRUPTION, 
+*                OR LOSS OF INFORMATION) ARISING OUT OF YOUR USE OF OR INABILITY TO USE 
+*                THE SOFTWARE, EVEN IF MTI HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH 
+*                DAMAGES. Because some jurisdictions prohibit the exclusion or 
+*                limitation of liability for consequential or incidental damages, the 
+*                above limitation may not apply to you.
+*
+*                Copyright 2006 Micron Technology, Inc. All rights reserved.
+*
+*
+* Rev  Author		Date		Changes
+* ---  ---------------	----------	-------------------------------
+* 1.0  ZS		08/07/2006	Initial release
+* 2.0  PF		03/05/2007	Expanded constants to allow 
+* 					larger fields
+* 
+* 
+/*******************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include "bch.h"
+
+int hextoint(char hex)
+// Convert HEX number to Integer
+{	int r, h;
+	r = -1;
+	h = (int)hex;
+	if ((h >= 97) && (h <= 102)) 
+		r = h - 87;
+	else if ((h >= 65) && (h <= 70)) 
+		r = h - 55;
+	else if ((h >= 48) && (h <= 57)) 
+		r = h - 48;
+	return r;
+}
+
+char inttohex(int i)
+// Convert Integer number to HEX
+{	char r;
+	if (i > 9)
+		r = (char)(55 + i);
+	else
+		r = (char)(48 + i);
+	return r;
+}
+
+void print_hex(int length, int Binary_data[length], FILE *std)
+// Print the binary data in HEX form
+// 1100 1010 = 5 3
+{	static const char hex[] = "0123456789ABCDEF";
+	char line[1024];
+	int j, l, n, v;
+	l = (length + 3) / 4;
+	
+	n = 0;
+	for (j = l - 1; j >= 0; j--) 
+	{	v = Binary_data[j * 4] | Binary_data[j * 4 + 1] << 1 | Binary_data[j * 4 + 2] << 2 | Binary_data[j * 4 + 3] << 3;
+		line[n++] = ' ';
+		line[n++] = hex[v];
+		if (n == sizeof(line))
+		{	fwrite(line, 1, n, std);
+			n = 0;
+		}
+	}
+	fwrite(line, 1, n, std);
+}
+
+void print_hex_low(int length, int Binary_data[length], FILE *std)
+// Print the binary data in HEX form from low to high order
+// 1100 1010 = C A
+{	static const char hex[] = "0123456789ABCDEF";
+	char line[1024];
+	int j, l, n, v;
+	l = (length + 3) / 4;
+	
+	n = 0;
+	for (j = 0; j < l; j++) 
+	{	v = Binary_data[j * 4] << 3 | Binary_data[j * 4 + 1] << 2 | Binary_data[j * 4 + 2] << 1 | Binary_data[j * 4 + 3];
+		line[n++] = hex[v];
+		if (n == sizeof(line))
+		{	fwrite(line, 1, n, std);
+			n = 0;
+		}
+	}
+	fwrite(line, 1, n, std);
+}
+
+void print_hex_bytes(int offset, int length, unsigned char *Packed_data, FILE *std)
+// Print length bits of packed data (MSB first in each byte), starting at bit
+// offset, in HEX form from low to high order.  offset must divide 4.
+// Whole bytes take two characters from one table lookup; the text is
+// written with one fwrite() per 1 KB.
+// 1100 1010 = C A
+{	static const char hex[] = "0123456789ABCDEF";
+	static char hex_pair[256][2];
+	char line[1024];
+	int i, j, l, n;
+	
+	if (hex_pair[0][0] == 0)
+		for (i = 255; i >= 0; i--)
+		{	hex_pair[i][1] = hex[i & 0x0f];
+			hex_pair[i][0] = hex[i >> 4];
+		}
+	l = (offset + length + 3) / 4;
+	
+	n = 0;
+	j = offset / 4;
+	if (j < l && (j & 1))
+		line[n++] = hex[Packed_data[j++ >> 1] & 0x0f];
+	for (; j + 1 < l; j += 2) 
+	{	memcpy(line + n, hex_pair[Packed_data[j >> 1]], 2);
+		n += 2;
+		if (n >= (int)sizeof(line) - 1)
+		{	fwrite(line, 1, n, std);
+			n = 0;
+		}
+	}
+	if (j < l)
+		line[n++] = hex[Packed_data[j >> 1] >> 4];
+	fwrite(line, 1, n, std);
+}
+
+void pack_bits(int length, int Binary_data[length], unsigned char *Packed_data)
+// Pack one bit per int into bytes, MSB first
+{	int i;
+	
+	memset(Packed_data, 0, (length + 7) / 8);
+	for (i = 0; i < length; i++) 
+		if (Binary_data[i])
+			Packed_data[i >> 3] |= 0x80 >> (i & 7);
+}
+
+void unpack_bits(int length, unsigned char *Packed_data, int Binary_data[length])
+// Expand packed bytes, MSB first, into one bit per int
+{	int i;
+	
+	for (i = 0; i < length; i++) 
+		Binary_data[i] = (Packed_data[i >> 3] >> (7 - (i & 7))) & 1;
+}
+
+typedef struct arena_block {
+	struct arena_block *next ;
+	size_t size, used ;
+} arena_block ;
+
+#define arena_align  64
+#define arena_chunk  65536		// Bytes per block, or the request if larger
+#define arena_header  ((sizeof(arena_block) + arena_align - 1) / arena_align * arena_align)
+
+static void *arena_alloc(bch_ctx *ctx, size_t size)
+/* size bytes, 64-byte aligned, carved from the context arena.  The tables of
+ * one code sit in a few contiguous blocks and are released together by
+ * bch_free().  Returns NULL if out of memory.
+ */
+{	arena_block *b = ctx->arena ;
+	size_t len ;
+	
+	size = (size + arena_align - 1) / arena_align * arena_align ;
+	if (b == NULL || b->size - b->used < size)
+	{	len = arena_header + (size > arena_chunk ? size : arena_chunk) ;
+		if (posix_memalign((void **)&b, arena_align, len) != 0)
+			return NULL ;
+		b->next = ctx->arena ;
+		b->size = len ;
+		b->used = arena_header ;
+		ctx->arena = b ;
+	}
+	b->used += size ;
+	return (char *)b + b->used - size ;
+}
+
+static void arena_free(bch_ctx *ctx)
+{	arena_block *b, *next ;
+	
+	for (b = ctx->arena; b != NULL; b = next)
+	{	next = b->next ;
+		free(b) ;
+	}
+	ctx->arena = NULL ;
+}
+
+
+void gen_primitive_poly(bch_ctx *ctx)
+/* Primitive polynomial p(X) of GF(2**mm) in p[0]..p[mm] */
+{	int i;
+	int mm = ctx->mm, *p = ctx->p ;
+	
+	// Primitive polynomials
+   	for (i = 1; i < mm; i++)
+		p[i] = 0;
+	p[0] = p[mm] = 1;
+	if (mm == 2)		p[1] = 1;
+	else if (mm == 3)	p[1] = 1;
+	else if (mm == 4)	p[1] = 1;
+	else if (mm == 5)	p[2] = 1;
+	else if (mm == 6)	p[1] = 1;
+	else if (mm == 7)	p[1] = 1;
+	else if (mm == 8)	p[4] = p[5] = p[6] = 1;
+	else if (mm == 9)	p[4] = 1;
+	else if (mm == 10)	p[3] = 1;
+	else if (mm == 11)	p[2] = 1;
+	else if (mm == 12)	p[3] = p[4] = p[7] = 1;
+	else if (mm == 13)	p[1] = p[2] = p[3] = p[5] = p[7] = p[8] = p[10] = 1;	// 25AF
+	// else if (mm == 13)	p[1] = p[3] = p[4] = 1;
+	else if (mm == 14)	p[2] = p[4] = p[6] = p[7] = p[8] = 1;	// 41D5
+	// else if (mm == 14)	p[1] = p[11] = p[12] = 1;
+	else if (mm == 15)	p[1] = 1;
+	else if (mm == 16)	p[2] = p[3] = p[5] = 1;
+	else if (mm == 17)	p[3] = 1;
+	else if (mm == 18)	p[7] = 1;
+	else if (mm == 19)	p[1] = p[5] = p[6] = 1;
+	else if (mm == 20)	p[3] = 1;
+}
+
+
+void generate_gf(bch_ctx *ctx)
+/* Generate GF(2**mm) from the primitive polynomial p(X) in p[0]..p[mm]
+   The lookup table looks like:  
+   index -> polynomial form:   alpha_to[ ] contains j = alpha**i;
+   polynomial form -> index form:  index_of[j = alpha**i] = i
+   alpha_to[1] = 2 is the primitive element of GF(2**mm)
+ */
+{	int i;
+	int mask ;	// Register states
+	int mm = ctx->mm, nn = ctx->nn, *p = ctx->p ;
+	int *alpha_to = ctx->alpha_to, *index_of = ctx->index_of ;
+	
+	gen_primitive_poly(ctx) ;
+	
+	if (ctx->Verbose)
+	{	fprintf(stderr, "# The Galois field is GF(2**%d);\n\n", mm);
+		fprintf(stderr, "# The primitive polynomial is: p(x) = ");
+		for (i = 0; i <= mm; i++) 
+		{	fprintf(stderr, " %d", p[i]);
+		}
+		fprintf(stderr, "\n\n");
+	}
+	
+	// Galois field implementation with shift registers
+	// Ref: L&C, Chapter 6.7, pp. 217
+	mask = 1 ;
+	alpha_to[mm] = 0 ;
+	for (i = 0; i < mm; i++)
+	{ 	alpha_to[i] = mask ;
+		index_of[alpha_to[i]] = i ;
+		if (p[i] != 0)
+			alpha_to[mm] ^= mask ;
+		
+		mask <<= 1 ;
+	}
+	
+	index_of[alpha_to[mm]] = mm ;
+	mask >>= 1 ;
+	for (i = mm + 1; i < nn; i++)
+	{ 	if (alpha_to[i-1] >= mask)
+			alpha_to[i] = alpha_to[mm] ^ ((alpha_to[i-1] ^ mask) << 1) ;
+		else alpha_to[i] = alpha_to[i-1] << 1 ;
+		
+		index_of[alpha_to[i]] = i ;
+	}
+	index_of[0] = -1 ;
+	
+	// Print out the Galois Field
+	if (ctx->Verbose)
+	{	fprintf(stderr, "# Look-up tables for GF(2**%2d)\n", mm) ;
+		fprintf(stderr, "  i   alpha_to[i]  index_of[i]\n") ;
+		for (i=0; i<=nn; i++)
+			fprintf(stderr, "%3d      %3d          %3d\n", i, alpha_to[i], index_of[i]) ;
+		fprintf(stderr, "\n") ;
+	}
+}
+
+
+int gen_poly(bch_ctx *ctx)
+/* Compute generator polynomial of the tt-error correcting Binary BCH code 
+ * g(x) = LCM{M_1(x), M_2(x), ..., M_2t(x)},
+ * where M_i(x) is the minimal polynomial of alpha^i by cyclotomic cosets.
+ * Sets rr and kk; g(x) is only built if rr <= rr_max.  Returns 0, or -1 if
+ * out of memory.
+ */
+{	int nn = ctx->nn, *gg ;
+	int *alpha_to = ctx->alpha_to, *index_of = ctx->index_of ;
+	uint64_t *gen_roots ;		// Bit i set if alpha**i is a root of g(x)
+	int i, j, Temp, rr ;
+	
+	gen_roots = calloc(nn / 64 + 1, sizeof(uint64_t)) ;
+	if (gen_roots == NULL)
+		return -1 ;
+
+	// Cyclotomic cosets of gen_roots
+   	for (i = 1; i <= 2*ctx->tt ; i++)
+	{	Temp = i % nn;
+		for (j = 0; j < ctx->mm; j++) 
+		{	gen_roots[Temp / 64] |= (uint64_t)1 << (Temp % 64) ;
+			Temp = (2 * Temp) % nn;		// 2**j * i mod nn
+		}
+	}
+	
+   	rr = 0;		// Count the number of parity check bits
+   	for (i = 0; i <= nn / 64; i++) 
+		rr += __builtin_popcountll(gen_roots[i]) ;
+	ctx->rr = rr;
+	ctx->kk = nn - rr;
+	if (rr > rr_max)
+	{	free(gen_roots) ;
+		return 0 ;
+	}
+	gg = ctx->gg = arena_alloc(ctx, (rr + 1) * sizeof(int)) ;
+	if (gg == NULL)
+	{	free(gen_roots) ;
+		return -1 ;
+	}
+	
+	// Compute generator polynomial based on its roots, in increasing order:
+	// g(x) = (X + alpha) initially, then times (X + alpha**Temp)
+	i = 0 ;
+	for (Temp = 1; Temp < nn; Temp++)
+	{	if (!(gen_roots[Temp / 64] & (uint64_t)1 << (Temp % 64)))
+			continue ;
+		if (++i == 1)
+		{	gg[0] = alpha_to[Temp] ;
+			gg[1] = 1 ;
+			continue ;
+		}
+	 	gg[i] = 1 ;
+		for (j = i - 1; j > 0; j--)
+		if (gg[j] != 0)  
+			gg[j] = gg[j-1]^ alpha_to[(index_of[gg[j]] + Temp) % nn] ;
+		else 
+			gg[j] = gg[j-1] ;
+		gg[0] = alpha_to[(index_of[gg[0]] + Temp) % nn] ;
+	}
+	free(gen_roots) ;
+	
+	if (ctx->Verbose)
+	{	fprintf(stderr, "# The Generator Polynomial is:\n") ;
+		for (i=0; i <= rr; i++)  
+			fprintf(stderr, " %d", gg[i]) ;
+		fprintf(stderr, "\n\n") ;
+	}
+	return 0 ;
+}
+
+
+int gen_lookahead(bch_ctx *ctx)
+/* Compute the parallel lookahead matrix T_G_R = T_G**Parallel from gg(x)
+ * for the bit-serial parallel encoder and syndrome computation.
+ * T_G is the companion matrix of gg(x), multiplying the register by x mod
+ * gg(x), so column j of T_G**Parallel is x**(j+Parallel) mod gg(x):  the
+ * columns are the successive states of the packed LFSR, with no matrix
+ * products.  Only the set entries of each row are kept.
+ * Returns -1 if out of memory.
+ */
+{	uint64_t reg[rem_words_max], fb ;
+	uint64_t poly[rem_words_max] ;
+	uint64_t *column ;
+	int i, j, n, w, rr, rem_words ;
+	
+	// for parallel encoding and syndrome computation
+	// Max parallalism is rr
+	rr = ctx->rr ;
+	if (ctx->Parallel > rr)
+		ctx->Parallel = rr ;
+	
+	rem_words = (rr + 63) / 64 ;
+	column = malloc((size_t)rr * rem_words * sizeof(uint64_t)) ;
+	ctx->T_G_R_row = arena_alloc(ctx, (rr + 1) * sizeof(int)) ;
+	if (column == NULL || ctx->T_G_R_row == NULL)
+	{	free(column) ;
+		return -1 ;
+	}
+	
+	// Bit i of the register is the coefficient of x**i, x**rr term implied
+	for (w = 0; w < rem_words; w++)
+	{	poly[w] = 0 ;
+		reg[w] = 0 ;
+	}
+	for (i = 0; i < rr; i++)
+		if (ctx->gg[i] != 0)
+			poly[i >> 6] |= (uint64_t)1 << (i & 63) ;
+	reg[0] = 1 ;
+	
+	// Construct T_g**r from gg(x), column j = x**(j+Parallel) mod gg(x)
+	// Ref: Parallel CRC, Shieh, 2001
+	for (j = -ctx->Parallel; j < rr; j++)
+	{	if (j >= 0)
+			memcpy(column + (size_t)j * rem_words, reg, rem_words * sizeof(uint64_t)) ;
+		
+		// reg = x * reg mod gg(x)
+		fb = (reg[(rr - 1) >> 6] >> ((rr - 1) & 63)) & 1 ;
+		for (w = rem_words - 1; w > 0; w--)
+			reg[w] = (reg[w] << 1) | (reg[w - 1] >> 63) ;
+		reg[0] <<= 1 ;
+		if (rr % 64)
+			reg[rem_words - 1] &= ((uint64_t)1 << (rr % 64)) - 1 ;
+		if (fb)
+			for (w = 0; w < rem_words; w++)
+				reg[w] ^= poly[w] ;
+	}
+	
+	// Set entries of each row
+	n = 0 ;
+	for (i = 0; i < rr; i++)
+	{	ctx->T_G_R_row[i] = n ;
+		for (j = 0; j < rr; j++)
+			n += (column[(size_t)j * rem_words + (i >> 6)] >> (i & 63)) & 1 ;
+	}
+	ctx->T_G_R_row[rr] = n ;
+	ctx->T_G_R_col = arena_alloc(ctx, (n ? n : 1) * sizeof(int)) ;
+	if (ctx->T_G_R_col == NULL)
+	{	free(column) ;
+		return -1 ;
+	}
+	n = 0 ;
+	for (i = 0; i < rr; i++)
+		for (j = 0; j < rr; j++)
+			if ((column[(size_t)j * rem_words + (i >> 6)] >> (i & 63)) & 1)
+				ctx->T_G_R_col[n++] = j ;
+	free(column) ;
+	return 0 ;
+}
+
+
+int gen_remainder_tables(bch_ctx *ctx)
+/* Build the slicing-by-8 tables for the packed, table driven remainder
+ * b(x) = x**rr * d(x) mod g(x), in the manner of a reflected CRC.
+ * The rr-bit register is held in rem_words 64-bit words, bit j being the
+ * coefficient of x**(rr-1-j), so the LSB of a data byte (its highest order
+ * bit) meets the feedback tap first.  Entry (s, v) is the register after 64
+ * shifts when started from byte v at bit 8*s.  Returns -1 if out of memory.
+ */
+{	uint64_t reg[rem_words_max], poly[rem_words_max], fb ;
+	int i, s, v, w, rr, rem_words ;
+	
+	rr = ctx->rr ;
+	rem_words = ctx->rem_words = (rr + 63) / 64 ;
+	ctx->rem_table = arena_alloc(ctx, (size_t)slice_max * 256 * rem_words * sizeof(uint64_t)) ;
+	if (ctx->rem_table == NULL)
+		return -1 ;
+	
+	// Reflected generator polynomial, x**rr term implied
+	for (w = 0; w < rem_words; w++)
+		poly[w] = 0 ;
+	for (i = 0; i < rr; i++)
+		if (ctx->gg[i] != 0)
+			poly[(rr - 1 - i) >> 6] |= (uint64_t)1 << ((rr - 1 - i) & 63) ;
+	
+	for (s = 0; s < slice_max; s++)
+	{	for (v = 0; v < 256; v++)
+		{	for (w = 0; w < rem_words; w++)
+				reg[w] = 0 ;
+			reg[0] = (uint64_t)v << (8 * s) ;
+			
+			for (i = 0; i < 64; i++)
+			{	fb = reg[0] & 1 ;
+				for (w = 0; w < rem_words - 1; w++)
+					reg[w] = (reg[w] >> 1) | (reg[w + 1] << 63) ;
+				reg[rem_words - 1] >>= 1 ;
+				if (fb)
+					for (w = 0; w < rem_words; w++)
+						reg[w] ^= poly[w] ;
+			}
+			
+			for (w = 0; w < rem_words; w++)
+				ctx->rem_table[(s * 256 + v) * rem_words + w] = reg[w] ;
+		}
+	}
+	return 0 ;
+}
+
+void packed_remainder(const bch_ctx *ctx, const unsigned char *Packed_data, int length, uint64_t *rem)
+/* Table driven remainder of length bytes of packed data, MSB first, where
+ * bit i of the stream is the coefficient of x**i.  The highest order byte is
+ * at the end of the buffer, so the stream is consumed 8 bytes at a time from
+ * the end; the leading partial chunk is zero padded above the data.
+ */
+{	const uint64_t *rem_table = ctx->rem_table ;
+	int rem_words = ctx->rem_words ;
+	unsigned char head[slice_max] ;
+	int n, w ;
+	
+	for (w = 0; w < rem_words; w++)
+		rem[w] = 0 ;
+	
+	n = length - length % slice_max ;
+	if (n != length)
+	{	memset(head, 0, slice_max) ;
+		memcpy(head, Packed_data + n, length - n) ;
+		remainder_step(rem_table, rem_words, rem, load_be64(head)) ;
+	}
+	while (n > 0)
+	{	n -= slice_max ;
+		remainder_step(rem_table, rem_words, rem, load_be64(Packed_data + n)) ;
+	}
+}
+
+int remainder_byte(const bch_ctx *ctx, const uint64_t *rem, int q)
+// Parity byte q (bits 8q .. 8q+7 of b(x), MSB first) from the reflected register
+{	int pos, w, sh ;
+	uint64_t v ;
+	
+	pos = ctx->rr - 8 - 8 * q ;
+	if (pos < 0)
+		return (int)(rem[0] << -pos) & 0xff ;
+	w = pos >> 6 ;
+	sh = pos & 63 ;
+	v = rem[w] >> sh ;
+	if (sh > 56)
+		v |= rem[w + 1] << (64 - sh) ;
+	return (int)v & 0xff ;
+}
+
+void remainder_xor_byte(const bch_ctx *ctx, uint64_t *rem, int q, int v)
+// Add parity byte q (bits 8q .. 8q+7 of b(x), MSB first) into the reflected register
+{	int pos, w, sh ;
+	
+	pos = ctx->rr - 8 - 8 * q ;
+	if (pos < 0)
+	{	rem[0] ^= (uint64_t)v >> -pos ;
+		return ;
+	}
+	w = pos >> 6 ;
+	sh = pos & 63 ;
+	rem[w] ^= (uint64_t)v << sh ;
+	if (sh > 56)
+		rem[w + 1] ^= (uint64_t)v >> (64 - sh) ;
+}
+
+void remainder_to_bytes(const bch_ctx *ctx, const uint64_t *rem, unsigned char *Packed_parity)
+// Unpack the reflected register into ceil(rr/8) parity bytes, MSB first
+{	int q ;
+	
+	for (q = 0; q < (ctx->rr + 7) / 8; q++)
+		Packed_parity[q] = remainder_byte(ctx, rem, q) ;
+}
+
+
+bch_ctx *bch_init(int m, int t, int k, int parallel, int flags, const char *kernel)
+/* Build the code context of the (m, t) code shortened to k data bits, or to
+ * the largest multiple of 4 that fits when k is 0.  parallel is the lookahead
+ * width of BCH_LOOKAHEAD and the positions per step of the scalar Chien
+ * search.  kernel names the vector kernel as for gf_select_kernel().
+ * Returns NULL if the parameters are not supported or out of memory.
+ */
+{	bch_ctx *ctx ;
+	
+	if (m < 2 || m > mm_max || t < 1 || t > tt_max || k < 0 || k % 4 != 0 || parallel < 1)
+		return NULL ;
+	ctx = calloc(1, sizeof(bch_ctx)) ;
+	if (ctx == NULL)
+		return NULL ;
+	ctx->mm = m ;
+	ctx->tt = t ;
+	ctx->nn = (1 << m) - 1 ;
+	ctx->Parallel = parallel ;
+	ctx->flags = flags ;
+	ctx->Verbose = (flags & BCH_VERBOSE) != 0 ;
+	if (gf_select_kernel(kernel, m, &ctx->gf) < 0)
+		goto fail ;
+	
+	// Tables of an earlier run, unless they are to be traced
+	gen_primitive_poly(ctx) ;
+	if ((flags & BCH_CACHE) && !ctx->Verbose && cache_load(ctx, parallel) == 0)
+		goto shorten ;
+	
+	// generate the Galois Field GF(2**mm)
+	ctx->alpha_to = arena_alloc(ctx, (ctx->nn + 1) * sizeof(int)) ;
+	ctx->index_of = arena_alloc(ctx, (ctx->nn + 1) * sizeof(int)) ;
+	if (ctx->alpha_to == NULL || ctx->index_of == NULL)
+		goto fail ;
+	generate_gf(ctx) ;
+	
+	// Compute the generator polynomial for BCH code
+	if (gen_poly(ctx) < 0 || ctx->rr > rr_max || ctx->kk < 4)
+		goto fail ;
+	
+	// Encoder and syndrome tables
+	if (flags & BCH_LOOKAHEAD)
+	{	if (gen_lookahead(ctx) < 0)
+			goto fail ;
+	}
+	if (gen_remainder_tables(ctx) < 0)
+		goto fail ;
+	
+	// Root finding
+	ctx->quad_table = arena_alloc(ctx, (ctx->nn + 1) * sizeof(int)) ;
+	if (ctx->quad_table == NULL)
+		goto fail ;
+	gen_quadratic_table(ctx) ;
+	if (flags & BCH_CACHE)
+		cache_store(ctx, parallel) ;
+	
+shorten:
+	// Check if code is shortened
+	if (k != 0)
+	{	if (k > ctx->kk)
+			goto fail ;
+		ctx->kk_shorten = k ;
+	}
+	else
+		// Make the shortened length divide 4
+		ctx->kk_shorten = ctx->kk - ctx->kk % 4 ;
+	ctx->nn_shorten = ctx->kk_shorten + ctx->rr ;
+	if (!(flags & BCH_GENERIC))
+		ctx->fixed = bch_fixed_find(ctx) ;
+	
+	// The scalar syndromes from S(x) use the byte tables of BCH_DIRECT
+	if ((flags & BCH_DIRECT) || (ctx->gf == NULL && ctx->fixed == NULL))
+	{	ctx->syn_table = arena_alloc(ctx, t * sizeof(*ctx->syn_table)) ;
+		if (ctx->syn_table == NULL)
+			goto fail ;
+		gen_syndrome_tables(ctx) ;
+	}
+	
+	// Vector kernel constants
+	if (ctx->gf)
+	{	ctx->syn_k = arena_alloc(ctx, t * sizeof(*ctx->syn_k)) ;
+		ctx->chien_k = arena_alloc(ctx, (t + 1) * sizeof(gf_const)) ;
+		if (ctx->syn_k == NULL || ctx->chien_k == NULL)
+			goto fail ;
+		gen_kernel_consts(ctx) ;
+	}
+	return ctx ;
+	
+fail:
+	bch_free(ctx) ;
+	return NULL ;
+}
+
+void bch_free(bch_ctx *ctx)
+{	if (ctx == NULL)
+		return ;
+	if (ctx->cache_map)
+		munmap(ctx->cache_map, ctx->cache_len) ;
+	arena_free(ctx) ;
+	free(ctx) ;
+}
+
+static size_t work_carve(size_t *size, size_t bytes)
+/* Offset of bytes more in the bch_work block of *size bytes */
+{	size_t at = *size ;
+
+	*size += (bytes + 63) / 64 * 64 ;
+	return at ;
+}
+
+bch_work *bch_work_new(const bch_ctx *ctx)
+/* Scratch state for one caller of bch_encode() and bch_decode(), sized for
+ * the code, with the bit-sliced data of bch_encode_batch() in the same block
+ */
+{	bch_work *w ;
+	size_t size, syn_in, chien_term, bb, s, location, slice ;
+	
+	size = 0 ;
+	work_carve(&size, sizeof(bch_work)) ;
+	syn_in = work_carve(&size, (size_t)(ctx->rr + gf_lanes - 1) / gf_lanes * sizeof(gf_planes)) ;
+	chien_term = work_carve(&size, (size_t)(ctx->tt + 1) * sizeof(gf_planes)) ;
+	bb = work_carve(&size, (size_t)ctx->rr * sizeof(int)) ;
+	s = work_carve(&size, (size_t)(2 * ctx->tt + 1) * sizeof(int)) ;
+	location = work_carve(&size, (size_t)ctx->tt * sizeof(int)) ;
+	slice = 0 ;
+	if (ctx->flags & BCH_LOOKAHEAD)
+		slice = work_carve(&size, (size_t)(ctx->kk_shorten + ctx->Parallel + 63) / 64 * 64 * sizeof(uint64_t)) ;
+	if (posix_memalign((void **)&w, 64, size) != 0)
+		return NULL ;
+	memset(w, 0, size) ;
+	w->syn_in = (gf_planes *)((char *)w + syn_in) ;
+	w->chien_term = (gf_planes *)((char *)w + chien_term) ;
+	w->bb = (int *)((char *)w + bb) ;
+	w->s = (int *)((char *)w + s) ;
+	w->location = (int *)((char *)w + location) ;
+	if (slice)
+		w->slice_data = (uint64_t *)((char *)w + slice) ;
+	return w ;
+}
+
+void bch_work_free(bch_work *w)
+{	free(w) ;
+}
@@ -0,0 +1,252 @@
+/*******************************************************************************
+*
+*    File Name:  bch_io.c
+*
+*  Description:  Input of the command line tools:  raw binary records
+*		  (--binary) and the hex text format
+*
+*     Function:   1. A regular file is mapped private and writable, so
+*		     whole batches of records are handed out in place and
+*		     corrected without a copy; only the pages written to are
+*		     duplicated.
+*		  2. Pipes and terminals are read in blocks of whole records
+*		     into one buffer.
+*		  3. Hex text is read in 64 KB blocks and packed straight into
+*		     bytes, MSB first.  Runs of 16 hex digits are checked and
+*		     converted in one SSE2 step; comments { } are skipped with
+*		     memchr().
+*
+*		  A record is one codeword (or data word) of a fixed number
+*		  of bytes.  Bytes after the last whole record are kept as the
+*		  tail, for the caller to pad or drop.
+*
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "bch.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define hex_block  65536		// Bytes per read of hex text
+
+bin_input *bin_open(int fd, int record, int max)
+/* Input of records of record bytes from fd, at most max per bin_read() */
+{	bin_input *in ;
+	struct stat st ;
+	void *map ;
+
+	in = calloc(1, sizeof(bin_input)) ;
+	if (in == NULL)
+		return NULL ;
+	in->fd = fd ;
+	in->record = record ;
+	in->max = max ;
+
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+	{	map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0) ;
+		if (map != MAP_FAILED)
+		{	in->map = map ;
+			in->map_len = st.st_size ;
+			madvise(map, st.st_size, MADV_SEQUENTIAL) ;
+			return in ;
+		}
+	}
+
+	in->buf = malloc((size_t)record * max) ;
+	if (in->buf == NULL)
+	{	free(in) ;
+		return NULL ;
+	}
+	return in ;
+}
+
+unsigned char *bin_read(bin_input *in, int *n)
+/* Next batch of whole records, writable, *n of them.  *n is 0 at the end of
+ * the input, with any trailing bytes of a partial record at in->tail.
+ */
+{	size_t len, left ;
+	ssize_t got ;
+	unsigned char *p ;
+
+	if (in->map)
+	{	left = in->map_len - in->pos ;
+		*n = left / in->record < (size_t)in->max ? left / in->record : (size_t)in->max ;
+		p = in->map + in->pos ;
+		in->pos += (size_t)*n * in->record ;
+		if (*n == 0)
+		{	in->tail = p ;
+			in->tail_len = left ;
+		}
+		return p ;
+	}
+
+	// Blocks are only short at the end of the input, so a partial record
+	// left by the previous call is the tail and there is nothing after it
+	len = in->tail_len ;
+	if (len)
+		memmove(in->buf, in->tail, len) ;
+	in->tail_len = 0 ;
+	while (len < (size_t)in->record * in->max)
+	{	got = read(in->fd, in->buf + len, (size_t)in->record * in->max - len) ;
+		if (got <= 0)
+			break ;
+		len += got ;
+	}
+	*n = len / in->record ;
+	in->tail = in->buf + (size_t)*n * in->record ;
+	in->tail_len = len - (size_t)*n * in->record ;
+	return in->buf ;
+}
+
+void bin_close(bin_input *in)
+{	if (in == NULL)
+		return ;
+	if (in->map)
+		munmap(in->map, in->map_len) ;
+	free(in->buf) ;
+	free(in) ;
+}
+
+hex_input *hex_open(int fd)
+{	hex_input *in ;
+
+	in = calloc(1, sizeof(hex_input)) ;
+	if (in == NULL)
+		return NULL ;
+	in->buf = malloc(hex_block) ;
+	if (in->buf == NULL)
+	{	free(in) ;
+		return NULL ;
+	}
+	in->fd = fd ;
+	return in ;
+}
+
+void hex_close(hex_input *in)
+{	if (in == NULL)
+		return ;
+	free(in->buf) ;
+	free(in) ;
+}
+
+static int hex_fill(hex_input *in)
+/* Refill an empty block.  Returns 0 at the end of the input. */
+{	ssize_t got ;
+
+	if (in->eof)
+		return 0 ;
+	got = read(in->fd, in->buf, hex_block) ;
+	if (got <= 0)
+	{	in->eof = 1 ;
+		return 0 ;
+	}
+	in->pos = 0 ;
+	in->len = got ;
+	return 1 ;
+}
+
+static inline int hex_pack16(const unsigned char *s, unsigned char *out)
+/* Pack 16 hex digits into 8 bytes.  Returns 0, storing nothing, if any of
+ * the characters is not a hex digit.
+ */
+#ifdef __SSE2__
+{	__m128i c, x, l, digit, alpha, v, w ;
+
+	// Unsigned range checks as signed compares on c ^ 0x80
+	c = _mm_loadu_si128((const __m128i *)s) ;
+	x = _mm_xor_si128(c, _mm_set1_epi8((char)0x80)) ;
+	l = _mm_xor_si128(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8((char)0x80)) ;
+	digit = _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8((char)(('0' - 1) ^ 0x80))),
+			      _mm_cmpgt_epi8(_mm_set1_epi8((char)(('9' + 1) ^ 0x80)), x)) ;
+	alpha = _mm_and_si128(_mm_cmpgt_epi8(l, _mm_set1_epi8((char)(('a' - 1) ^ 0x80))),
+			      _mm_cmpgt_epi8(_mm_set1_epi8((char)(('f' + 1) ^ 0x80)), l)) ;
+	if (_mm_movemask_epi8(_mm_or_si128(digit, alpha)) != 0xffff)
+		return 0 ;
+
+	// '0'..'9' -> 0..9, 'A'..'F' and 'a'..'f' -> 1..6 + 9
+	v = _mm_add_epi8(_mm_and_si128(c, _mm_set1_epi8(0x0f)), _mm_and_si128(alpha, _mm_set1_epi8(9))) ;
+	// Even digit to the high nibble, odd digit to the low nibble
+	w = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(v, _mm_set1_epi16(0x00ff)), 4), _mm_srli_epi16(v, 8)) ;
+	_mm_storel_epi64((__m128i *)out, _mm_packus_epi16(w, w)) ;
+	return 1 ;
+}
+#else
+{	int i, hi, lo ;
+
+	for (i = 0; i < 16; i++)
+		if (hextoint(s[i]) < 0)
+			return 0 ;
+	for (i = 0; i < 8; i++)
+	{	hi = hextoint(s[2 * i]) ;
+		lo = hextoint(s[2 * i + 1]) ;
+		out[i] = hi << 4 | lo ;
+	}
+	return 1 ;
+}
+#endif
+
+int hex_read(hex_input *in, unsigned char *Packed_data, int nibbles, int record)
+/* Read up to nibbles hex digits into Packed_data, MSB first, skipping all
+ * other characters and comments { }.  With record set, the first other
+ * character (or comment) after a digit ends the read; a record that fills
+ * Packed_data is continued by the next call.  Returns the number of digits
+ * read; in->eof is set if the input ran out.
+ */
+{	unsigned char *p ;
+	int count, v ;
+
+	count = 0 ;
+	while (count < nibbles)
+	{	if (in->pos == in->len && !hex_fill(in))
+			break ;
+		if (in->comment)
+		{	p = memchr(in->buf + in->pos, '}', in->len - in->pos) ;
+			if (p == NULL)
+			{	in->pos = in->len ;
+				continue ;
+			}
+			in->pos = p - in->buf + 1 ;
+			in->comment = 0 ;
+			if (record && (count || in->in_record))
+			{	in->in_record = 0 ;
+				break ;
+			}
+			continue ;
+		}
+
+		// Whole bytes, 16 digits at a time
+		if ((count & 1) == 0)
+			while (nibbles - count >= 16 && in->len - in->pos >= 16
+			       && hex_pack16(in->buf + in->pos, Packed_data + (count >> 1)))
+			{	in->pos += 16 ;
+				count += 16 ;
+			}
+		if (count == nibbles || in->pos == in->len)
+			continue ;
+
+		v = hextoint(in->buf[in->pos]) ;
+		if (v != -1)
+		{	if (count & 1)
+				Packed_data[count >> 1] |= v ;
+			else
+				Packed_data[count >> 1] = v << 4 ;
+			count++ ;
+		}
+		else if (in->buf[in->pos] == '{')
+			in->comment = 1 ;
+		else if (record && (count || in->in_record))
+		{	in->pos++ ;
+			in->in_record = 0 ;
+			break ;
+		}
+		in->pos++ ;
+	}
+	if (record && count == nibbles)
+		in->in_record = 1 ;
+	return count ;
+}
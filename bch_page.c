@@ -0,0 +1,187 @@
+/*******************************************************************************
+*
+*    File Name:  bch_page.c
+*
+*  Description:  libbch NAND page codec:  every sector of a page, data in the
+*		  main area and parity in the spare area, in one call
+*
+*     Function:   1. bch_page_layout_spare() and bch_page_layout_interleaved()
+*		     describe where the data and the parity of each sector are
+*		     in the raw page.  Other layouts can fill bch_page_layout
+*		     directly.
+*		  2. bch_page_encode() writes the parity of every sector of n
+*		     pages into their spare areas.
+*		  3. bch_page_decode() gathers the sectors of n pages into
+*		     codewords, decodes them together on the bch_pool given to
+*		     bch_page_new(), if any, and flips the corrected bits in
+*		     the pages.  Clean sectors are not written back.
+*
+*		  k must divide 8, so the data of a sector is whole bytes and
+*		  its parity starts on a byte.  The bits of the last parity
+*		  byte past r are not part of the codeword:  the encoder
+*		  writes them as zeros and the decoder ignores them.
+*
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "bch.h"
+
+struct bch_page {
+	const bch_ctx *ctx ;
+	bch_page_layout layout ;
+	int pages ;			// Pages per call at most
+	int data_bytes, parity_bytes, stride ;
+	bch_pool *pool ;		// Decoder threads, or NULL
+	bch_work *work ;		// Scratch state without them
+	unsigned char *codewords ;	// Sectors gathered as codewords
+	int *location ;
+} ;
+
+void bch_page_layout_spare(const bch_ctx *ctx, bch_page_layout *layout, int sectors, int spare_offset)
+{	int data_bytes = ctx->kk_shorten / 8, parity_bytes = (ctx->rr + 7) / 8 ;
+
+	layout->sectors = sectors ;
+	layout->data_offset = 0 ;
+	layout->data_stride = data_bytes ;
+	layout->parity_offset = sectors * data_bytes + spare_offset ;
+	layout->parity_stride = parity_bytes ;
+	layout->page_bytes = layout->parity_offset + sectors * parity_bytes ;
+}
+
+void bch_page_layout_interleaved(const bch_ctx *ctx, bch_page_layout *layout, int sectors)
+{	int data_bytes = ctx->kk_shorten / 8, parity_bytes = (ctx->rr + 7) / 8 ;
+
+	layout->sectors = sectors ;
+	layout->data_offset = 0 ;
+	layout->data_stride = data_bytes + parity_bytes ;
+	layout->parity_offset = data_bytes ;
+	layout->parity_stride = data_bytes + parity_bytes ;
+	layout->page_bytes = sectors * (data_bytes + parity_bytes) ;
+}
+
+static int layout_fits(const bch_page_layout *l, int offset, int stride, int bytes)
+/* 1 if every sector's field of bytes at offset + i * stride is in the page */
+{	long last ;
+
+	last = offset + (long)(l->sectors - 1) * stride ;
+	return offset >= 0 && last >= 0 && last + bytes <= l->page_bytes ;
+}
+
+bch_page *bch_page_new(const bch_ctx *ctx, const bch_page_layout *layout, int pages, bch_pool *pool)
+/* Codec of up to pages pages per call, decoding on pool if not NULL.  Returns
+ * NULL if k does not divide 8, the layout does not fit in the page or out of
+ * memory.
+ */
+{	bch_page *pg ;
+	int n ;
+
+	if (ctx->kk_shorten % 8 != 0 || layout->sectors < 1 || pages < 1)
+		return NULL ;
+	pg = calloc(1, sizeof(bch_page)) ;
+	if (pg == NULL)
+		return NULL ;
+	pg->ctx = ctx ;
+	pg->layout = *layout ;
+	pg->pages = pages ;
+	pg->data_bytes = ctx->kk_shorten / 8 ;
+	pg->parity_bytes = (ctx->rr + 7) / 8 ;
+	pg->stride = (ctx->nn_shorten + 7) / 8 ;
+	if (!layout_fits(layout, layout->data_offset, layout->data_stride, pg->data_bytes)
+	 || !layout_fits(layout, layout->parity_offset, layout->parity_stride, pg->parity_bytes))
+	{	free(pg) ;
+		return NULL ;
+	}
+
+	n = pages * layout->sectors ;
+	pg->pool = pool ;
+	pg->work = bch_work_new(ctx) ;
+	pg->codewords = malloc((size_t)n * pg->stride) ;
+	pg->location = malloc((size_t)n * ctx->tt * sizeof(int)) ;
+	if (pg->work == NULL || pg->codewords == NULL || pg->location == NULL)
+	{	bch_page_free(pg) ;
+		return NULL ;
+	}
+	return pg ;
+}
+
+void bch_page_free(bch_page *pg)
+{	if (pg == NULL)
+		return ;
+	bch_work_free(pg->work) ;
+	free(pg->codewords) ;
+	free(pg->location) ;
+	free(pg) ;
+}
+
+void bch_page_encode(bch_page *pg, unsigned char *pages, int n)
+/* Write the parity of every sector of n pages, page_bytes apart */
+{	const bch_page_layout *l = &pg->layout ;
+	unsigned char *page ;
+	int p ;
+
+	for (p = 0; p < n; p++)
+	{	page = pages + (size_t)p * l->page_bytes ;
+		bch_encode_batch(pg->ctx, pg->work, page + l->data_offset, l->data_stride, l->sectors,
+				 page + l->parity_offset, l->parity_stride) ;
+	}
+}
+
+int bch_page_decode(bch_page *pg, unsigned char *pages, int n, int *count)
+/* Correct the sectors of n pages, page_bytes apart, in place.  count[p *
+ * sectors + i] is the result of bch_decode() for sector i of page p.  Returns
+ * the most bits corrected in a sector, or -1 if a sector is unable to decode.
+ */
+{	const bch_ctx *ctx = pg->ctx ;
+	const bch_page_layout *l = &pg->layout ;
+	unsigned char *page, *codeword, *data, *parity ;
+	int p, i, c, j, bit, worst ;
+
+	if (n > pg->pages)
+		n = pg->pages ;
+	// Gather each sector into a codeword:  data then parity, MSB first
+	for (p = 0; p < n; p++)
+	{	page = pages + (size_t)p * l->page_bytes ;
+		for (i = 0; i < l->sectors; i++)
+		{	codeword = pg->codewords + (size_t)(p * l->sectors + i) * pg->stride ;
+			memcpy(codeword, page + l->data_offset + (size_t)i * l->data_stride, pg->data_bytes) ;
+			memcpy(codeword + pg->data_bytes, page + l->parity_offset + (size_t)i * l->parity_stride, pg->parity_bytes) ;
+			if (ctx->rr % 8)
+				codeword[pg->stride - 1] &= 0xff << (8 - ctx->rr % 8) ;
+		}
+	}
+
+	if (pg->pool)
+		bch_decode_batch(pg->pool, pg->codewords, pg->stride, n * l->sectors, count, pg->location) ;
+	else
+		for (c = 0; c < n * l->sectors; c++)
+		{	count[c] = bch_decode(ctx, pg->work, pg->codewords + (size_t)c * pg->stride) ;
+			for (j = 0; j < count[c]; j++)
+				pg->location[c * ctx->tt + j] = pg->work->location[j] ;
+		}
+
+	// Flip the corrected bits in the page
+	worst = 0 ;
+	for (p = 0; p < n; p++)
+	{	page = pages + (size_t)p * l->page_bytes ;
+		for (i = 0; i < l->sectors; i++)
+		{	c = p * l->sectors + i ;
+			if (count[c] < 0)
+				worst = -1 ;
+			else if (worst >= 0 && count[c] > worst)
+				worst = count[c] ;
+			data = page + l->data_offset + (size_t)i * l->data_stride ;
+			parity = page + l->parity_offset + (size_t)i * l->parity_stride ;
+			for (j = 0; j < count[c]; j++)
+			{	bit = pg->location[c * ctx->tt + j] ;
+				if (bit < ctx->kk_shorten)
+					data[bit >> 3] ^= 0x80 >> (bit & 7) ;
+				else
+				{	bit -= ctx->kk_shorten ;
+					parity[bit >> 3] ^= 0x80 >> (bit & 7) ;
+				}
+			}
+		}
+	}
+	return worst ;
+}
@@ -0,0 +1,297 @@
+/*******************************************************************************
+*
+*    File Name:  bch_pipe.c
+*
+*  Description:  libbch streaming decoder:  a reader thread, decode workers
+*		  and an ordered writer over a ring of batch slots
+*
+*     Function:   1. bch_pipe_new() allocates a fixed ring of slots, each
+*		     holding a batch of packed codewords and their results,
+*		     and one bch_work per worker.  Nothing is allocated per
+*		     codeword or per batch afterwards.
+*		  2. bch_pipe_run() starts the reader thread, which fills free
+*		     slots in order from the source callback, and the workers,
+*		     which take filled batches by ticket and decode them.  The
+*		     calling thread is the writer:  it hands finished batches to
+*		     the sink callback in input order and frees their slots.
+*
+*		  Slot i carries batches i, i + slots, ...; its state word is
+*		  lap * 4 + phase (free, filled, decoded), so every hand-off
+*		  is one atomic store and the ring needs no locks.  The reader
+*		  and writer each own one end (single producer, single
+*		  consumer); workers claim batches with a fetch-and-add ticket
+*		  and wait on the count of filled batches, whose top bit marks
+*		  the end of the input.  A thread that has to wait spins
+*		  briefly, then sleeps on the word with a futex; wakes are only
+*		  issued when someone sleeps.
+*
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include "bch.h"
+#ifdef __linux__
+#include <unistd.h>
+#include <limits.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+#define pipe_free  0
+#define pipe_filled  1
+#define pipe_decoded  2
+#define pipe_end  0x80000000u		// In filled:  no batches will follow
+#define pipe_spin  256			// Polls before a waiter sleeps
+
+typedef struct {
+	_Atomic uint32_t state ;	// lap * 4 + phase
+	int n ;				// Codewords in the batch
+	unsigned char *codewords ;
+	int *count, *location ;		// bch_decode() results
+	bch_stats stats ;		// Of this batch (BCH_STATS)
+} __attribute__((aligned(64))) pipe_slot ;
+
+typedef struct {
+	bch_pipe *pipe ;
+	bch_work *work ;
+	pthread_t thread ;
+} __attribute__((aligned(64))) pipe_worker ;
+
+struct bch_pipe {
+	const bch_ctx *ctx ;
+	int workers, batch, slots, stride ;
+	pipe_slot *slot ;
+	pipe_worker *worker ;
+	_Atomic uint32_t filled ;	// Batches filled, | pipe_end at the end
+	_Atomic uint32_t ticket ;	// Next batch for a worker
+	_Atomic int sleepers ;		// Threads in futex_wait()
+	bch_stats total ;		// Of the batches handed to the sink
+	pthread_t reader ;
+	// Input of the current run
+	bch_pipe_read source ;
+	void *arg ;
+} ;
+
+static void pipe_wait(bch_pipe *pipe, _Atomic uint32_t *word, uint32_t seen)
+/* Block while *word == seen */
+{	int i ;
+
+	for (i = 0; i < pipe_spin; i++)
+	{	if (atomic_load(word) != seen)
+			return ;
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause() ;
+#endif
+	}
+	atomic_fetch_add(&pipe->sleepers, 1) ;
+	while (atomic_load(word) == seen)
+#ifdef __linux__
+		syscall(SYS_futex, (uint32_t *)word, FUTEX_WAIT_PRIVATE, seen, NULL, NULL, 0) ;
+#else
+		sched_yield() ;
+#endif
+	atomic_fetch_sub(&pipe->sleepers, 1) ;
+}
+
+static void pipe_set(bch_pipe *pipe, _Atomic uint32_t *word, uint32_t value)
+/* Publish a new value of a word other threads may be waiting on */
+{	atomic_store(word, value) ;
+#ifdef __linux__
+	if (atomic_load(&pipe->sleepers) > 0)
+		syscall(SYS_futex, (uint32_t *)word, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0) ;
+#endif
+}
+
+static uint32_t pipe_state(uint32_t batch, int slots, int phase)
+{	return (batch / slots) * 4 + phase ;
+}
+
+static void *reader_main(void *arg)
+{	bch_pipe *pipe = arg ;
+	pipe_slot *s ;
+	uint32_t b, v ;
+
+	for (b = 0; ; b++)
+	{	s = &pipe->slot[b % pipe->slots] ;
+		while ((v = atomic_load(&s->state)) != pipe_state(b, pipe->slots, pipe_free))
+			pipe_wait(pipe, &s->state, v) ;
+		s->n = pipe->source(pipe->arg, s->codewords, pipe->batch) ;
+		if (s->n <= 0)
+			break ;
+		pipe_set(pipe, &s->state, pipe_state(b, pipe->slots, pipe_filled)) ;
+		pipe_set(pipe, &pipe->filled, b + 1) ;
+	}
+	pipe_set(pipe, &pipe->filled, b | pipe_end) ;
+	return NULL ;
+}
+
+static int pipe_ready(bch_pipe *pipe, uint32_t b)
+/* Wait until batch b is filled.  Returns 0 if there is no batch b. */
+{	uint32_t f ;
+
+	for (;;)
+	{	f = atomic_load(&pipe->filled) ;
+		if ((f & ~pipe_end) > b)
+			return 1 ;
+		if (f & pipe_end)
+			return 0 ;
+		pipe_wait(pipe, &pipe->filled, f) ;
+	}
+}
+
+static void *worker_main(void *arg)
+{	pipe_worker *me = arg ;
+	bch_pipe *pipe = me->pipe ;
+	const bch_ctx *ctx = pipe->ctx ;
+	pipe_slot *s ;
+	uint32_t b ;
+	int c, j ;
+
+	for (;;)
+	{	b = atomic_fetch_add(&pipe->ticket, 1) ;
+		if (!pipe_ready(pipe, b))
+			return NULL ;
+		s = &pipe->slot[b % pipe->slots] ;
+		// The writer sums the batches, so no one reads the counters of
+		// a worker while it updates them
+		if (ctx->flags & BCH_STATS)
+			memset(&me->work->stats, 0, sizeof(bch_stats)) ;
+		for (c = 0; c < s->n; c++)
+		{	s->count[c] = bch_decode(ctx, me->work, s->codewords + (size_t)c * pipe->stride) ;
+			for (j = 0; j < s->count[c]; j++)
+				s->location[c * ctx->tt + j] = me->work->location[j] ;
+		}
+		if (ctx->flags & BCH_STATS)
+			s->stats = me->work->stats ;
+		pipe_set(pipe, &s->state, pipe_state(b, pipe->slots, pipe_decoded)) ;
+	}
+}
+
+bch_pipe *bch_pipe_new(const bch_ctx *ctx, int workers, int batch)
+/* Pipeline of workers decode threads over batches of batch codewords.
+ * Returns NULL if out of memory.
+ */
+{	bch_pipe *pipe ;
+	pipe_slot *s ;
+	int i ;
+
+	if (workers < 1)
+		workers = 1 ;
+	if (batch < 1)
+		batch = 1 ;
+	pipe = calloc(1, sizeof(bch_pipe)) ;
+	if (pipe == NULL)
+		return NULL ;
+	pipe->ctx = ctx ;
+	pipe->workers = workers ;
+	pipe->batch = batch ;
+	// Enough batches in flight to keep every worker busy while the reader
+	// and the writer each hold one
+	pipe->slots = 2 * workers + 2 ;
+	pipe->stride = (ctx->nn_shorten + 7) / 8 ;
+	if (posix_memalign((void **)&pipe->slot, 64, pipe->slots * sizeof(pipe_slot)) != 0)
+	{	free(pipe) ;
+		return NULL ;
+	}
+	memset(pipe->slot, 0, pipe->slots * sizeof(pipe_slot)) ;
+	if (posix_memalign((void **)&pipe->worker, 64, workers * sizeof(pipe_worker)) != 0)
+		goto fail ;
+	memset(pipe->worker, 0, workers * sizeof(pipe_worker)) ;
+
+	for (i = 0; i < pipe->slots; i++)
+	{	s = &pipe->slot[i] ;
+		s->codewords = malloc((size_t)batch * pipe->stride) ;
+		s->count = malloc(batch * sizeof(int)) ;
+		s->location = malloc((size_t)batch * ctx->tt * sizeof(int)) ;
+		if (s->codewords == NULL || s->count == NULL || s->location == NULL)
+			goto fail ;
+	}
+	for (i = 0; i < workers; i++)
+	{	pipe->worker[i].pipe = pipe ;
+		pipe->worker[i].work = bch_work_new(ctx) ;
+		if (pipe->worker[i].work == NULL)
+			goto fail ;
+	}
+	return pipe ;
+
+fail:
+	bch_pipe_free(pipe) ;
+	return NULL ;
+}
+
+void bch_pipe_free(bch_pipe *pipe)
+{	int i ;
+
+	if (pipe == NULL)
+		return ;
+	for (i = 0; i < pipe->slots; i++)
+	{	free(pipe->slot[i].codewords) ;
+		free(pipe->slot[i].count) ;
+		free(pipe->slot[i].location) ;
+	}
+	if (pipe->worker)
+		for (i = 0; i < pipe->workers; i++)
+			bch_work_free(pipe->worker[i].work) ;
+	free(pipe->worker) ;
+	free(pipe->slot) ;
+	free(pipe) ;
+}
+
+long bch_pipe_run(bch_pipe *pipe, bch_pipe_read source, bch_pipe_write sink, void *arg)
+/* Decode everything source() returns, handing each batch to sink() in input
+ * order on the calling thread.  source() is called on the reader thread
+ * with room for the batch size and returns the codewords it stored, 0 at the
+ * end.  Returns the number of codewords, or -1 if the threads cannot be
+ * started.
+ */
+{	pipe_slot *s ;
+	uint32_t b, v ;
+	long words ;
+	int i, started ;
+
+	for (i = 0; i < pipe->slots; i++)
+		atomic_init(&pipe->slot[i].state, pipe_free) ;
+	atomic_init(&pipe->filled, 0) ;
+	atomic_init(&pipe->ticket, 0) ;
+	atomic_init(&pipe->sleepers, 0) ;
+	pipe->source = source ;
+	pipe->arg = arg ;
+
+	for (started = 0; started < pipe->workers; started++)
+		if (pthread_create(&pipe->worker[started].thread, NULL, worker_main, &pipe->worker[started]) != 0)
+			break ;
+	if (started < pipe->workers || pthread_create(&pipe->reader, NULL, reader_main, pipe) != 0)
+	{	// Let the workers started see an empty input
+		pipe_set(pipe, &pipe->filled, pipe_end) ;
+		for (i = 0; i < started; i++)
+			pthread_join(pipe->worker[i].thread, NULL) ;
+		return -1 ;
+	}
+
+	words = 0 ;
+	for (b = 0; pipe_ready(pipe, b); b++)
+	{	s = &pipe->slot[b % pipe->slots] ;
+		while ((v = atomic_load(&s->state)) != pipe_state(b, pipe->slots, pipe_decoded))
+			pipe_wait(pipe, &s->state, v) ;
+		if (pipe->ctx->flags & BCH_STATS)
+			bch_stats_add(&pipe->total, &s->stats) ;
+		sink(arg, words, s->n, s->codewords, s->count, s->location) ;
+		words += s->n ;
+		pipe_set(pipe, &s->state, pipe_state(b + pipe->slots, pipe->slots, pipe_free)) ;
+	}
+
+	pthread_join(pipe->reader, NULL) ;
+	for (i = 0; i < pipe->workers; i++)
+		pthread_join(pipe->worker[i].thread, NULL) ;
+	return words ;
+}
+
+void bch_pipe_stats(const bch_pipe *pipe, bch_stats *sum)
+/* Totals of the batches handed to the sink so far.  Call it from the sink
+ * or between runs:  it reads what the writer sums, not the workers.
+ */
+{	*sum = pipe->total ;
+}
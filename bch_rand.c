@@ -0,0 +1,87 @@
+/*******************************************************************************
+*
+*    File Name:  bch_rand.c
+*
+*  Description:  libbch random numbers for the simulator and the error
+*		  generator
+*
+*     Function:   1. bch_rng_seed() starts the xoshiro256** generator of
+*		     stream s of a seed.  The state is taken from outputs
+*		     4s .. 4s + 3 of the splitmix64 sequence of the seed, so
+*		     distinct streams start from distinct states and a stream
+*		     depends only on (seed, s), not on which thread runs it.
+*		  2. bch_rng_gap() is the number of correct bits before the
+*		     next error of a binary symmetric channel (geometric skip):
+*		     a channel is simulated at the cost of its errors, not of
+*		     its bits.
+*		  3. bch_rng_sample() draws w distinct positions out of n
+*		     (Floyd's algorithm):  exactly w errors, none cancelling
+*		     another.
+*
+*******************************************************************************/
+
+#include <math.h>
+#include <limits.h>
+#include "bch.h"
+
+#define rng_golden  0x9e3779b97f4a7c15ull
+
+static uint64_t splitmix(uint64_t z)
+{	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull ;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull ;
+	return z ^ (z >> 31) ;
+}
+
+void bch_rng_seed(bch_rng *r, uint64_t seed, uint64_t stream)
+{	uint64_t x ;
+	int i ;
+
+	x = splitmix(seed) + 4 * stream * rng_golden ;
+	for (i = 0; i < 4; i++)
+		r->s[i] = splitmix(x += rng_golden) ;
+}
+
+uint64_t bch_rng_below(bch_rng *r, uint64_t n)
+/* Uniform in [0, n), without the bias of a modulo (Lemire) */
+{	unsigned __int128 m ;
+	uint64_t low, floor ;
+
+	m = (unsigned __int128)bch_rng_next(r) * n ;
+	low = (uint64_t)m ;
+	if (low < n)
+	{	floor = -n % n ;
+		while (low < floor)
+		{	m = (unsigned __int128)bch_rng_next(r) * n ;
+			low = (uint64_t)m ;
+		}
+	}
+	return m >> 64 ;
+}
+
+long bch_rng_gap(bch_rng *r, double log_q)
+/* Bits without error before the next one of a channel of bit error rate p,
+ * log_q being log(1 - p)
+ */
+{	double gap ;
+
+	if (log_q >= 0)
+		return LONG_MAX ;
+	// u in (0, 1], so the log is finite
+	gap = floor(log(((bch_rng_next(r) >> 11) + 1) * 0x1p-53) / log_q) ;
+	return gap < (double)LONG_MAX ? (long)gap : LONG_MAX ;
+}
+
+void bch_rng_sample(bch_rng *r, int n, int w, int *pos)
+/* w distinct positions in [0, n) into pos, w <= n.  Each draw checks the
+ * ones before it, so this is meant for weights of the order of t.
+ */
+{	int i, j, c ;
+
+	for (i = 0, j = n - w; i < w; i++, j++)
+	{	pos[i] = bch_rng_below(r, j + 1) ;
+		for (c = 0; c < i && pos[c] != pos[i]; c++)
+			;
+		if (c < i)
+			pos[i] = j ;
+	}
+}
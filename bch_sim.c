@@ -0,0 +1,681 @@
+/*******************************************************************************
+*
+*    File Name:  bch_sim.c
+*
+*  Description:  In process Monte Carlo characterization of a BCH code
+*
+*     Function:   1. For each point of a sweep over error weights (-e) or raw
+*		     bit error rates (-b), generates random data, encodes it,
+*		     injects the errors and decodes, on every core, with no
+*		     files in between.
+*		  2. Counts frame errors (codewords not restored), of them the
+*		     miscorrections (decoded to another codeword) and the data
+*		     bits left wrong, and writes the rates with their Wilson
+*		     confidence intervals to <stdout>.
+*		  3. Saves the totals to a checkpoint file (-c) every
+*		     df_save seconds, at the end of each point and on SIGINT
+*		     or SIGTERM; a run given the same file resumes from it.
+*
+*		  Codeword i of point p draws all its random numbers from
+*		  stream p * 2^40 + i of the seed, and the totals are summed
+*		  over rounds of sim_round codewords, so the results do not
+*		  depend on the number of threads, and a resumed run ends
+*		  with the totals of one that was never stopped.  Stopping a
+*		  point after -f frame errors is decided at the end of a round.
+*
+*******************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "bch.h"
+
+#define df_n  1000000			// Codewords per point
+#define df_level  95.0			// Confidence level, %
+#define df_save  60			// Seconds between checkpoints
+#define df_progress  10			// Seconds between progress reports
+#define sim_round  65536		// Codewords between totals
+#define sim_chunk  256			// Codewords a thread takes at a time
+#define sim_stream_bits  40		// Codewords of a point at most 2^40
+#define sim_magic  "bch_sim 1"
+
+typedef struct {
+	uint64_t codewords ;
+	uint64_t raw_errors ;		// Bits flipped by the channel
+	uint64_t frame_errors ;		// Codewords not restored
+	uint64_t miscorrected ;		// Of them decoded to another codeword
+	uint64_t bit_errors ;		// Data bits wrong after decoding
+} sim_count ;
+
+typedef struct {
+	int weight ;			// Errors per codeword, or -1:
+	double ber ;			// raw bit error rate
+	double log_q ;			// log(1 - ber)
+	sim_count total ;
+	int done ;
+} sim_point ;
+
+typedef struct {
+	bch_work *work ;
+	unsigned char *clean, *word ;
+	int *pos ;
+	sim_count count ;		// Of the current round
+	pthread_t thread ;
+} __attribute__((aligned(64))) sim_worker ;
+
+const bch_ctx *ctx ;
+int Zero ;				// All zero codewords, no data or encoding
+uint64_t Seed ;
+int Threads ;
+sim_worker *worker ;
+sim_point *point ;
+int points ;
+// Current round, handed to the workers under lock
+pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER ;
+pthread_cond_t start = PTHREAD_COND_INITIALIZER, done = PTHREAD_COND_INITIALIZER ;
+unsigned round_id ;			// Rounds handed out so far
+int running ;				// Helper threads still on the round
+int quit ;
+int round_point ;
+uint64_t round_first, round_n ;
+_Atomic uint64_t round_next ;		// Next codeword of the round to take
+volatile sig_atomic_t stop_request ;	// SIGINT or SIGTERM received
+
+void stop_signal(int sig)
+{	(void)sig ;
+	stop_request = 1 ;
+}
+
+static double now_s(void)
+{	struct timespec ts ;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts) ;
+	return ts.tv_sec + ts.tv_nsec * 1e-9 ;
+}
+
+static int data_errors(const unsigned char *word, const unsigned char *clean, int bytes)
+/* Bits that differ in the first bytes */
+{	uint64_t a, b ;
+	int i, n ;
+
+	n = 0 ;
+	for (i = 0; i + 8 <= bytes; i += 8)
+	{	memcpy(&a, word + i, 8) ;
+		memcpy(&b, clean + i, 8) ;
+		n += __builtin_popcountll(a ^ b) ;
+	}
+	for (; i < bytes; i++)
+		n += __builtin_popcount(word[i] ^ clean[i]) ;
+	return n ;
+}
+
+static void sim_codeword(sim_worker *me, const sim_point *pt, uint64_t stream)
+/* One codeword through the channel and the decoder */
+{	bch_rng rng ;
+	uint64_t x ;
+	long b ;
+	int i, data_bytes, stride, count ;
+
+	data_bytes = ctx->kk_shorten / 8 ;
+	stride = (ctx->nn_shorten + 7) / 8 ;
+	bch_rng_seed(&rng, Seed, stream) ;
+	if (!Zero)
+	{	for (i = 0; i < data_bytes; i += 8)
+		{	x = bch_rng_next(&rng) ;
+			memcpy(me->clean + i, &x, data_bytes - i < 8 ? data_bytes - i : 8) ;
+		}
+		bch_encode(ctx, me->work, me->clean, me->clean + data_bytes) ;
+	}
+	memcpy(me->word, me->clean, stride) ;
+
+	if (pt->weight >= 0)
+	{	bch_rng_sample(&rng, ctx->nn_shorten, pt->weight, me->pos) ;
+		for (i = 0; i < pt->weight; i++)
+			me->word[me->pos[i] >> 3] ^= 0x80 >> (me->pos[i] & 7) ;
+		me->count.raw_errors += pt->weight ;
+	}
+	else
+		for (b = bch_rng_gap(&rng, pt->log_q); b < ctx->nn_shorten; b += 1 + bch_rng_gap(&rng, pt->log_q))
+		{	me->word[b >> 3] ^= 0x80 >> (b & 7) ;
+			me->count.raw_errors++ ;
+		}
+
+	count = bch_decode(ctx, me->work, me->word) ;
+	me->count.codewords++ ;
+	if (memcmp(me->word, me->clean, stride) != 0)
+	{	me->count.frame_errors++ ;
+		if (count >= 0)
+			me->count.miscorrected++ ;
+		me->count.bit_errors += data_errors(me->word, me->clean, data_bytes) ;
+	}
+}
+
+static void run_round(sim_worker *me)
+{	const sim_point *pt = &point[round_point] ;
+	uint64_t c, end ;
+
+	memset(&me->count, 0, sizeof(sim_count)) ;
+	for (;;)
+	{	c = atomic_fetch_add(&round_next, sim_chunk) ;
+		if (c >= round_n)
+			return ;
+		end = c + sim_chunk < round_n ? c + sim_chunk : round_n ;
+		for (; c < end; c++)
+			sim_codeword(me, pt, ((uint64_t)round_point << sim_stream_bits) + round_first + c) ;
+	}
+}
+
+static void *worker_main(void *arg)
+{	sim_worker *me = arg ;
+	unsigned seen ;
+
+	seen = 0 ;
+	for (;;)
+	{	pthread_mutex_lock(&lock) ;
+		while (round_id == seen && !quit)
+			pthread_cond_wait(&start, &lock) ;
+		seen = round_id ;
+		pthread_mutex_unlock(&lock) ;
+		if (quit)
+			return NULL ;
+
+		run_round(me) ;
+
+		pthread_mutex_lock(&lock) ;
+		if (--running == 0)
+			pthread_cond_signal(&done) ;
+		pthread_mutex_unlock(&lock) ;
+	}
+}
+
+static void sim_round_run(int p, uint64_t n)
+/* The next n codewords of point p on every thread, the caller included,
+ * added to its totals
+ */
+{	sim_count *t = &point[p].total ;
+	int i ;
+
+	round_point = p ;
+	round_first = t->codewords ;
+	round_n = n ;
+	atomic_store(&round_next, 0) ;
+	pthread_mutex_lock(&lock) ;
+	running = Threads - 1 ;
+	round_id++ ;
+	pthread_cond_broadcast(&start) ;
+	pthread_mutex_unlock(&lock) ;
+
+	run_round(&worker[0]) ;
+
+	pthread_mutex_lock(&lock) ;
+	while (running > 0)
+		pthread_cond_wait(&done, &lock) ;
+	pthread_mutex_unlock(&lock) ;
+
+	for (i = 0; i < Threads; i++)
+	{	t->codewords += worker[i].count.codewords ;
+		t->raw_errors += worker[i].count.raw_errors ;
+		t->frame_errors += worker[i].count.frame_errors ;
+		t->miscorrected += worker[i].count.miscorrected ;
+		t->bit_errors += worker[i].count.bit_errors ;
+	}
+}
+
+static int parse_points(const char *weights, const char *bers)
+/* Point list from "a,b:c,..." (weights a and b .. c) or "x,lo:hi:n,..."
+ * (rates x and n rates from lo to hi, evenly spaced on a log scale).
+ * Returns -1 if the list is invalid.
+ */
+{	const char *s ;
+	char *end ;
+	double lo = 0, hi = 0 ;
+	sim_point *grown ;
+	long a, b, i, n ;
+
+	points = 0 ;
+	a = 0 ;
+	for (s = weights ? weights : bers; *s; s = *end ? end + 1 : end)
+	{	if (weights)
+		{	a = b = strtol(s, &end, 10) ;
+			if (*end == ':')
+				b = strtol(end + 1, &end, 10) ;
+			if (end == s || (*end && *end != ',') || a < 0 || b < a || b > ctx->nn_shorten || b - a > 100000)
+				return -1 ;
+			n = b - a + 1 ;
+		}
+		else
+		{	lo = hi = strtod(s, &end) ;
+			n = 1 ;
+			if (*end == ':')
+			{	hi = strtod(end + 1, &end) ;
+				if (*end != ':')
+					return -1 ;
+				n = strtol(end + 1, &end, 10) ;
+			}
+			if (end == s || (*end && *end != ',') || !(lo > 0) || !(hi >= lo) || hi >= 1 || n < 1 || n > 100000
+			 || (n == 1 && hi != lo))
+				return -1 ;
+		}
+		grown = realloc(point, (points + n) * sizeof(sim_point)) ;
+		if (grown == NULL)
+			return -1 ;
+		point = grown ;
+		for (i = 0; i < n; i++)
+		{	memset(&point[points], 0, sizeof(sim_point)) ;
+			if (weights)
+				point[points].weight = a + i ;
+			else
+			{	point[points].weight = -1 ;
+				point[points].ber = n > 1 ? lo * pow(hi / lo, (double)i / (n - 1)) : lo ;
+				point[points].log_q = log1p(-point[points].ber) ;
+			}
+			points++ ;
+		}
+	}
+	return points ? 0 : -1 ;
+}
+
+static void point_key(const sim_point *pt, char *key, size_t len)
+{	if (pt->weight >= 0)
+		snprintf(key, len, "e %d", pt->weight) ;
+	else
+		snprintf(key, len, "b %.17g", pt->ber) ;
+}
+
+static void run_key(char *key, size_t len)
+/* What the totals of a checkpoint depend on, besides the points */
+{	snprintf(key, len, "m %d t %d k %d seed %llu zero %d", ctx->mm, ctx->tt, ctx->kk_shorten,
+		 (unsigned long long)Seed, Zero) ;
+}
+
+static int load_checkpoint(const char *path)
+/* Totals of a previous run of the same code and points.  Returns 0 if there
+ * is no file, -1 if it belongs to another run.
+ */
+{	char line[512], key[256], pkey[64] ;
+	sim_count *t ;
+	FILE *f ;
+	int p, len ;
+
+	f = fopen(path, "r") ;
+	if (f == NULL)
+		return 0 ;
+	run_key(key, sizeof(key)) ;
+	if (fgets(line, sizeof(line), f) == NULL || strcmp(line, sim_magic "\n") != 0
+	 || fgets(line, sizeof(line), f) == NULL || strncmp(line, key, strlen(key)) != 0 || line[strlen(key)] != '\n')
+		goto fail ;
+	for (p = 0; p < points; p++)
+	{	point_key(&point[p], pkey, sizeof(pkey)) ;
+		t = &point[p].total ;
+		len = strlen(pkey) ;
+		if (fgets(line, sizeof(line), f) == NULL || strncmp(line, pkey, len) != 0
+		 || sscanf(line + len, " codewords %llu raw %llu frame %llu miscorrected %llu bits %llu",
+			   (unsigned long long *)&t->codewords, (unsigned long long *)&t->raw_errors,
+			   (unsigned long long *)&t->frame_errors, (unsigned long long *)&t->miscorrected,
+			   (unsigned long long *)&t->bit_errors) != 5)
+			goto fail ;
+	}
+	fclose(f) ;
+	return 1 ;
+
+fail:
+	fclose(f) ;
+	for (p = 0; p < points; p++)
+		memset(&point[p].total, 0, sizeof(sim_count)) ;
+	return -1 ;
+}
+
+static int save_checkpoint(const char *path)
+/* Written under a temporary name and renamed, so a crash leaves the last
+ * complete checkpoint.  Returns -1 if it cannot be written.
+ */
+{	char temp[4200], key[256], pkey[64] ;
+	const sim_count *t ;
+	FILE *f ;
+	int p, ok ;
+
+	snprintf(temp, sizeof(temp), "%s.%d", path, (int)getpid()) ;
+	f = fopen(temp, "w") ;
+	if (f == NULL)
+		return -1 ;
+	run_key(key, sizeof(key)) ;
+	fprintf(f, "%s\n%s\n", sim_magic, key) ;
+	for (p = 0; p < points; p++)
+	{	point_key(&point[p], pkey, sizeof(pkey)) ;
+		t = &point[p].total ;
+		fprintf(f, "%s codewords %llu raw %llu frame %llu miscorrected %llu bits %llu\n", pkey,
+			(unsigned long long)t->codewords, (unsigned long long)t->raw_errors,
+			(unsigned long long)t->frame_errors, (unsigned long long)t->miscorrected,
+			(unsigned long long)t->bit_errors) ;
+	}
+	ok = fflush(f) == 0 && fsync(fileno(f)) == 0 ;
+	if (fclose(f) != 0 || !ok || rename(temp, path) != 0)
+	{	unlink(temp) ;
+		return -1 ;
+	}
+	return 0 ;
+}
+
+static double z_score(double level)
+/* Two sided standard normal quantile of a confidence level in % */
+{	double lo, hi, z ;
+	int i ;
+
+	lo = 0 ;
+	hi = 40 ;
+	for (i = 0; i < 100; i++)
+	{	z = (lo + hi) / 2 ;
+		if (erfc(z / sqrt(2)) > 1 - level / 100)
+			lo = z ;
+		else
+			hi = z ;
+	}
+	return z ;
+}
+
+static void wilson(uint64_t x, uint64_t n, double z, double *lo, double *hi)
+/* Wilson score interval of the rate x / n */
+{	double p, d, c, h ;
+
+	if (n == 0)
+	{	*lo = 0 ;
+		*hi = 1 ;
+		return ;
+	}
+	p = (double)x / n ;
+	d = 1 + z * z / n ;
+	c = (p + z * z / (2.0 * n)) / d ;
+	h = z * sqrt(p * (1 - p) / n + z * z / (4.0 * n * n)) / d ;
+	*lo = x == 0 || c - h < 0 ? 0 : c - h ;
+	*hi = x == n || c + h > 1 ? 1 : c + h ;
+}
+
+static void report(const sim_point *pt, double z)
+{	const sim_count *t = &pt->total ;
+	double fer_lo, fer_hi, mis_lo, mis_hi, n ;
+
+	n = t->codewords ? (double)t->codewords : 1 ;
+	wilson(t->frame_errors, t->codewords, z, &fer_lo, &fer_hi) ;
+	wilson(t->miscorrected, t->codewords, z, &mis_lo, &mis_hi) ;
+	if (pt->weight >= 0)
+		fprintf(stdout, "%6d %10s", pt->weight, "-") ;
+	else
+		fprintf(stdout, "%6s %10.3e", "-", pt->ber) ;
+	fprintf(stdout, " %10.3e %14llu %12llu %10.3e %10.3e %10.3e %12llu %10.3e %10.3e %10.3e %10.3e\n",
+		t->raw_errors / (n * ctx->nn_shorten), (unsigned long long)t->codewords,
+		(unsigned long long)t->frame_errors, t->frame_errors / n, fer_lo, fer_hi,
+		(unsigned long long)t->miscorrected, t->miscorrected / n, mis_lo, mis_hi,
+		t->bit_errors / (n * ctx->kk_shorten)) ;
+	fflush(stdout) ;
+}
+
+int main(int argc, char **argv)
+{	int i, p, Help, started, interrupted, max_weight ;
+	int mm, tt, kk, Parallel, flags ;
+	long long Codewords, Failures ;
+	double Level, z, t0, t_save, t_progress, now ;
+	const char *Kernel, *Weights, *Rates, *Checkpoint ;
+	const gf_kernel *kern ;
+	struct sigaction sa ;
+	uint64_t n, total ;
+	bch_ctx *code ;
+
+	fprintf(stderr, "# BCH code Monte Carlo simulation.  Use -h for details.\n\n") ;
+
+	Help = 0 ;
+	mm = df_m ;
+	tt = df_t ;
+	kk = 0 ;
+	Parallel = df_p ;
+	flags = BCH_CACHE ;
+	Kernel = NULL ;
+	Weights = Rates = Checkpoint = NULL ;
+	Codewords = df_n ;
+	Failures = 0 ;
+	Level = df_level ;
+	Seed = 1 ;
+	Zero = 0 ;
+	Threads = sysconf(_SC_NPROCESSORS_ONLN) ;
+	if (Threads < 1)
+		Threads = 1 ;
+	for (i = 1; i < argc; i++)
+	{	if (argv[i][0] == '-')
+		{	switch (argv[i][1])
+			{	case 'm': mm = i + 1 < argc ? atoi(argv[++i]) : -1 ;
+					  break ;
+				case 't': tt = i + 1 < argc ? atoi(argv[++i]) : -1 ;
+					  break ;
+				case 'k': kk = i + 1 < argc ? atoi(argv[++i]) : -1 ;
+					  break ;
+				case 'p': Parallel = i + 1 < argc ? atoi(argv[++i]) : -1 ;
+					  break ;
+				case 'g': Kernel = i + 1 < argc ? argv[++i] : "" ;
+					  break ;
+				case 'i': flags |= BCH_INVERSIONLESS ;
+					  break ;
+				case 'j': Threads = i + 1 < argc ? atoi(argv[++i]) : -1 ;
+					  break ;
+				case 'e': Weights = i + 1 < argc ? argv[++i] : "" ;
+					  break ;
+				case 'b': Rates = i + 1 < argc ? argv[++i] : "" ;
+					  break ;
+				case 'n': Codewords = i + 1 < argc ? atoll(argv[++i]) : -1 ;
+					  break ;
+				case 'f': Failures = i + 1 < argc ? atoll(argv[++i]) : -1 ;
+					  break ;
+				case 's': if (i + 1 < argc)
+						Seed = strtoull(argv[++i], NULL, 0) ;
+					  else
+						Help = 1 ;
+					  break ;
+				case 'z': Zero = 1 ;
+					  break ;
+				case 'c': Checkpoint = i + 1 < argc ? argv[++i] : "" ;
+					  break ;
+				case 'l': Level = i + 1 < argc ? atof(argv[++i]) : -1 ;
+					  break ;
+				default: Help = 1 ;
+			}
+		}
+		else
+			Help = 1 ;
+	}
+	if (mm < 0 || tt < 1 || kk < 0 || kk % 8 || Parallel < 1 || Threads < 1 || Codewords < 1
+	 || Codewords >= 1ll << sim_stream_bits || Failures < 0 || !(Level > 0 && Level < 100)
+	 || (Weights && Rates) || (Checkpoint && *Checkpoint == 0))
+		Help = 1 ;
+	else if (gf_select_kernel(Kernel, mm, &kern) < 0)
+	{	fprintf(stderr, "### GF kernel %s is not supported.\n\n", Kernel) ;
+		Help = 1 ;
+	}
+
+	if (Help)
+	{	fprintf(stdout, "# Usage %s:  Monte Carlo frame error rate of a BCH code\n", argv[0]) ;
+		fprintf(stdout, "    -h:  This help message\n") ;
+		fprintf(stdout, "    -m <field>:  Galois field, GF, for code.  Default = %d\n", df_m) ;
+		fprintf(stdout, "    -t <correct>:  Correction power of the code.  Default = %d\n", df_t) ;
+		fprintf(stdout, "    -k <data bits>:  Number of data bits, which must divide 8.  Default is\n") ;
+		fprintf(stdout, "         the maximum supported by the code, rounded down to whole bytes.\n") ;
+		fprintf(stdout, "    -p <parallel>:  Positions per step of the scalar Chien search.\n") ;
+		fprintf(stdout, "         Default = %d\n", df_p) ;
+		fprintf(stdout, "    -i   Solve the key equation with the inversionless Berlekamp-Massey\n") ;
+		fprintf(stdout, "         algorithm.  Default disabled.\n") ;
+		fprintf(stdout, "    -g <kernel>:  GF(2^m) kernel:  scalar, ssse3, avx2 or gfni.  Default is\n") ;
+		fprintf(stdout, "         the best the CPU supports.\n") ;
+		fprintf(stdout, "    -e <weights>:  Sweep exactly this many errors per codeword, distinct\n") ;
+		fprintf(stdout, "         bits, as a list of weights w and ranges w1:w2.  Default is t .. t + 4.\n") ;
+		fprintf(stdout, "    -b <rates>:  Sweep the raw bit error rate of a binary symmetric channel\n") ;
+		fprintf(stdout, "         instead, as a list of rates p and ranges p1:p2:<points>, evenly\n") ;
+		fprintf(stdout, "         spaced on a log scale, such as 1e-4:1e-2:9.\n") ;
+		fprintf(stdout, "    -n <codewords>:  Codewords per point, less than 2^%d.  Default = %d\n",
+			sim_stream_bits, df_n) ;
+		fprintf(stdout, "    -f <failures>:  Stop a point once it has this many frame errors,\n") ;
+		fprintf(stdout, "         checked every %d codewords.  Default = 0, never.\n", sim_round) ;
+		fprintf(stdout, "    -s <seed>:  Seed of the random numbers.  Default = 1\n") ;
+		fprintf(stdout, "    -z   All zero codewords:  no data generated or encoded, as a linear\n") ;
+		fprintf(stdout, "         code decodes every codeword alike.  Default disabled.\n") ;
+		fprintf(stdout, "    -j <threads>:  Threads.  Results do not depend on it.  Default is the\n") ;
+		fprintf(stdout, "         number of cores.\n") ;
+		fprintf(stdout, "    -c <file>:  Checkpoint file, saved every %d seconds and when stopped by\n", df_save) ;
+		fprintf(stdout, "         SIGINT or SIGTERM.  A run with the same code, seed, -z and points\n") ;
+		fprintf(stdout, "         resumes from it; -n and -f may be raised.  Default none.\n") ;
+		fprintf(stdout, "    -l <level>:  Confidence level of the intervals, %%.  Default = %g\n", df_level) ;
+		fprintf(stdout, "    The code tables are cached in $BCH_CACHE_DIR (default ~/.cache/bch).\n") ;
+		fprintf(stdout, "    <stdout>:  one line per point:  weight or channel rate, raw BER measured,\n") ;
+		fprintf(stdout, "         codewords, frame errors, FER and its interval, miscorrections,\n") ;
+		fprintf(stdout, "         their rate and its interval, and the BER of the decoded data.\n") ;
+		fprintf(stdout, "    <stderr>:  progress and error messages\n") ;
+		return 0 ;
+	}
+
+	code = bch_init(mm, tt, kk, Parallel, flags, Kernel) ;
+	if (code == NULL)
+	{	fprintf(stderr, "### Unsupported code:  m = %d, t = %d, k = %d.\n\n", mm, tt, kk) ;
+		return 1 ;
+	}
+	if (code->kk_shorten % 8)
+	{	// The longest data that is whole bytes
+		kk = code->kk_shorten & ~7 ;
+		bch_free(code) ;
+		code = bch_init(mm, tt, kk, Parallel, flags, Kernel) ;
+		if (code == NULL)
+		{	fprintf(stderr, "### Unsupported code:  m = %d, t = %d, k = %d.\n\n", mm, tt, kk) ;
+			return 1 ;
+		}
+	}
+	ctx = code ;
+	if (!Weights && !Rates)
+	{	static char sweep[32] ;
+
+		snprintf(sweep, sizeof(sweep), "%d:%d", ctx->tt, ctx->tt + 4) ;
+		Weights = sweep ;
+	}
+	if (parse_points(Weights, Rates) < 0)
+	{	fprintf(stderr, "### Invalid sweep %s.\n\n", Weights ? Weights : Rates) ;
+		return 1 ;
+	}
+	max_weight = 0 ;
+	for (p = 0; p < points; p++)
+		if (point[p].weight > max_weight)
+			max_weight = point[p].weight ;
+	if (Checkpoint)
+	{	i = load_checkpoint(Checkpoint) ;
+		if (i < 0)
+		{	fprintf(stderr, "### %s is the checkpoint of another run.\n\n", Checkpoint) ;
+			return 1 ;
+		}
+		if (i > 0)
+			fprintf(stderr, "# Resuming from %s.\n", Checkpoint) ;
+	}
+
+	if (posix_memalign((void **)&worker, 64, Threads * sizeof(sim_worker)) != 0)
+	{	fprintf(stderr, "### Out of memory.\n\n") ;
+		return 1 ;
+	}
+	memset(worker, 0, Threads * sizeof(sim_worker)) ;
+	for (i = 0; i < Threads; i++)
+	{	worker[i].work = bch_work_new(ctx) ;
+		worker[i].clean = calloc(1, (ctx->nn_shorten + 7) / 8) ;
+		worker[i].word = malloc((ctx->nn_shorten + 7) / 8) ;
+		worker[i].pos = malloc((max_weight + 1) * sizeof(int)) ;
+		if (worker[i].work == NULL || worker[i].clean == NULL || worker[i].word == NULL || worker[i].pos == NULL)
+		{	fprintf(stderr, "### Out of memory.\n\n") ;
+			return 1 ;
+		}
+	}
+	for (started = 1; started < Threads; started++)
+		if (pthread_create(&worker[started].thread, NULL, worker_main, &worker[started]) != 0)
+			break ;
+	Threads = started ;
+
+	memset(&sa, 0, sizeof(sa)) ;
+	sa.sa_handler = stop_signal ;
+	sigaction(SIGINT, &sa, NULL) ;
+	sigaction(SIGTERM, &sa, NULL) ;
+
+	z = z_score(Level) ;
+	fprintf(stderr, "# m = %d, t = %d, k = %d, n = %d, seed = %llu, %d threads%s.\n\n", ctx->mm, ctx->tt,
+		ctx->kk_shorten, ctx->nn_shorten, (unsigned long long)Seed, Threads, Zero ? ", all zero codewords" : "") ;
+	fprintf(stdout, "# m = %d, t = %d, k = %d, n = %d, seed = %llu, %g%% Wilson intervals\n", ctx->mm, ctx->tt,
+		ctx->kk_shorten, ctx->nn_shorten, (unsigned long long)Seed, Level) ;
+	fprintf(stdout, "# %4s %10s %10s %14s %12s %10s %10s %10s %12s %10s %10s %10s %10s\n", "errors", "channel",
+		"raw_ber", "codewords", "frame_errors", "fer", "fer_low", "fer_high", "miscorrected", "mis_rate",
+		"mis_low", "mis_high", "data_ber") ;
+
+	t0 = t_save = t_progress = now_s() ;
+	total = 0 ;
+	interrupted = 0 ;
+	for (p = 0; p < points && !interrupted; p++)
+	{	sim_point *pt = &point[p] ;
+
+		for (;;)
+		{	pt->done = pt->total.codewords >= (uint64_t)Codewords
+				   || (Failures && pt->total.frame_errors >= (uint64_t)Failures) ;
+			if (pt->done || stop_request)
+				break ;
+			n = Codewords - pt->total.codewords ;
+			// Rounds stay aligned to sim_round whatever -n was before a resume
+			if (n > sim_round - pt->total.codewords % sim_round)
+				n = sim_round - pt->total.codewords % sim_round ;
+			sim_round_run(p, n) ;
+			total += n ;
+
+			now = now_s() ;
+			if (now - t_progress >= df_progress)
+			{	fprintf(stderr, "# Point %d of %d:  %llu codewords, %llu frame errors, %.3g codewords/s\n",
+					p + 1, points, (unsigned long long)pt->total.codewords,
+					(unsigned long long)pt->total.frame_errors, total / (now - t0)) ;
+				t_progress = now ;
+			}
+			if (Checkpoint && now - t_save >= df_save)
+			{	if (save_checkpoint(Checkpoint) < 0)
+					fprintf(stderr, "### Cannot write %s.\n", Checkpoint) ;
+				t_save = now ;
+			}
+		}
+		if (!pt->done)
+			interrupted = 1 ;
+		else
+		{	if (pt->weight >= 0 && pt->weight <= ctx->tt && pt->total.frame_errors)
+				fprintf(stderr, "### %llu codewords with %d errors failed to decode.\n",
+					(unsigned long long)pt->total.frame_errors, pt->weight) ;
+			report(pt, z) ;
+			if (Checkpoint && save_checkpoint(Checkpoint) < 0)
+				fprintf(stderr, "### Cannot write %s.\n", Checkpoint) ;
+			t_save = now_s() ;
+		}
+	}
+
+	pthread_mutex_lock(&lock) ;
+	quit = 1 ;
+	pthread_cond_broadcast(&start) ;
+	pthread_mutex_unlock(&lock) ;
+	for (i = 1; i < Threads; i++)
+		pthread_join(worker[i].thread, NULL) ;
+
+	now = now_s() ;
+	fprintf(stderr, "\n# %llu codewords in %.1f s, %.3g codewords/s.\n", (unsigned long long)total, now - t0,
+		now > t0 ? total / (now - t0) : 0) ;
+	if (interrupted)
+	{	if (Checkpoint && save_checkpoint(Checkpoint) < 0)
+			fprintf(stderr, "### Cannot write %s.\n", Checkpoint) ;
+		fprintf(stderr, "### Stopped at point %d of %d%s.\n\n", p, points,
+			Checkpoint ? ", run again to resume" : "") ;
+		return 1 ;
+	}
+	for (i = 0; i < Threads; i++)
+	{	bch_work_free(worker[i].work) ;
+		free(worker[i].clean) ;
+		free(worker[i].word) ;
+		free(worker[i].pos) ;
+	}
+	free(worker) ;
+	free(point) ;
+	bch_free(code) ;
+	return 0 ;
+}
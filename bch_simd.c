@@ -0,0 +1,289 @@
+/*******************************************************************************
+*
+*    File Name:  bch_simd.c
+*
+*  Description:  Vectorized GF(2**mm) kernels for the BCH decoder
+*
+*     Function:   1. Multiply 32 field elements by a constant per step
+*		  2. Syndromes from S(x) by lane-split Horner's rule
+*		  3. Chien search over 32 positions per step
+*
+*		  Elements are held as two byte planes (low and high byte of
+*		  each of 32 lanes), so mm <= 16.  A constant multiply is a
+*		  GF(2) linear map, applied either as PSHUFB nibble tables
+*		  (SSSE3, AVX2) or as four 8x8 GF2P8AFFINEQB matrices (GFNI).
+*		  The kernel is picked from CPUID when the code context is
+*		  built; a NULL kernel means the scalar alpha_to/index_of code
+*		  is used.
+*
+*		  PCLMULQDQ is not used: with 16-bit elements one 64x64
+*		  carry-less product covers two lanes at most, which loses to
+*		  the nibble tables before the reduction is even paid for.
+*
+*   References:
+* 		  1. Screaming Fast Galois Field Arithmetic Using Intel SIMD
+*		     Instructions, Plank, Greenan & Miller, 2013
+*
+*******************************************************************************/
+
+#include <string.h>
+#include "bch.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GF_X86  1
+#endif
+
+void gf_prepare_const(const bch_ctx *ctx, gf_const *k, int c)
+/* Tables for multiplication by c (polynomial form).  Column b of the linear
+ * map is c * alpha**b, which is c times the basis element x**b.
+ */
+{	int col[16], b, n, v, i, prod ;
+
+	for (b = 0; b < 16; b++)
+		if (b < ctx->mm && c != 0)
+			col[b] = ctx->alpha_to[(ctx->index_of[c] + b) % ctx->nn] ;
+		else
+			col[b] = 0 ;
+
+	for (n = 0; n < 4; n++)
+		for (v = 0; v < 16; v++)
+		{	prod = 0 ;
+			for (b = 0; b < 4; b++)
+				if (v & (1 << b))
+					prod ^= col[4 * n + b] ;
+			k->nib[2 * n][v] = prod & 0xff ;
+			k->nib[2 * n + 1][v] = prod >> 8 ;
+		}
+
+	// Output bit i of a byte is the parity of matrix byte 7-i AND the input byte
+	for (n = 0; n < 4; n++)
+		k->aff[n] = 0 ;
+	for (i = 0; i < 8; i++)
+		for (b = 0; b < 8; b++)
+		{	if ((col[b] >> i) & 1)
+				k->aff[0] |= (uint64_t)1 << (8 * (7 - i) + b) ;
+			if ((col[b + 8] >> i) & 1)
+				k->aff[1] |= (uint64_t)1 << (8 * (7 - i) + b) ;
+			if ((col[b] >> (i + 8)) & 1)
+				k->aff[2] |= (uint64_t)1 << (8 * (7 - i) + b) ;
+			if ((col[b + 8] >> (i + 8)) & 1)
+				k->aff[3] |= (uint64_t)1 << (8 * (7 - i) + b) ;
+		}
+}
+
+#ifdef GF_X86
+
+// SSSE3: 32 lanes as two 128-bit halves
+
+__attribute__((target("ssse3")))
+static inline void mulc_ssse3_half(__m128i *lo, __m128i *hi, const gf_const *k)
+{	__m128i mask, n0, n1, n2, n3, rlo, rhi ;
+
+	mask = _mm_set1_epi8(0x0f) ;
+	n0 = _mm_and_si128(*lo, mask) ;
+	n1 = _mm_and_si128(_mm_srli_epi16(*lo, 4), mask) ;
+	n2 = _mm_and_si128(*hi, mask) ;
+	n3 = _mm_and_si128(_mm_srli_epi16(*hi, 4), mask) ;
+
+	rlo = _mm_xor_si128(_mm_shuffle_epi8(_mm_load_si128((const __m128i *)k->nib[0]), n0),
+			    _mm_shuffle_epi8(_mm_load_si128((const __m128i *)k->nib[2]), n1)) ;
+	rlo = _mm_xor_si128(rlo, _mm_shuffle_epi8(_mm_load_si128((const __m128i *)k->nib[4]), n2)) ;
+	rlo = _mm_xor_si128(rlo, _mm_shuffle_epi8(_mm_load_si128((const __m128i *)k->nib[6]), n3)) ;
+	rhi = _mm_xor_si128(_mm_shuffle_epi8(_mm_load_si128((const __m128i *)k->nib[1]), n0),
+			    _mm_shuffle_epi8(_mm_load_si128((const __m128i *)k->nib[3]), n1)) ;
+	rhi = _mm_xor_si128(rhi, _mm_shuffle_epi8(_mm_load_si128((const __m128i *)k->nib[5]), n2)) ;
+	rhi = _mm_xor_si128(rhi, _mm_shuffle_epi8(_mm_load_si128((const __m128i *)k->nib[7]), n3)) ;
+	*lo = rlo ;
+	*hi = rhi ;
+}
+
+__attribute__((target("ssse3")))
+static void mulc_ssse3(gf_planes *x, const gf_const *k)
+{	__m128i lo, hi ;
+	int h ;
+
+	for (h = 0; h < gf_lanes; h += 16)
+	{	lo = _mm_load_si128((const __m128i *)(x->lo + h)) ;
+		hi = _mm_load_si128((const __m128i *)(x->hi + h)) ;
+		mulc_ssse3_half(&lo, &hi, k) ;
+		_mm_store_si128((__m128i *)(x->lo + h), lo) ;
+		_mm_store_si128((__m128i *)(x->hi + h), hi) ;
+	}
+}
+
+__attribute__((target("ssse3")))
+static void horner_ssse3(gf_planes *acc, const gf_const *k, const gf_planes *in, int n)
+{	__m128i lo, hi ;
+	int h, q ;
+
+	for (h = 0; h < gf_lanes; h += 16)
+	{	lo = _mm_load_si128((const __m128i *)(acc->lo + h)) ;
+		hi = _mm_load_si128((const __m128i *)(acc->hi + h)) ;
+		for (q = n - 1; q >= 0; q--)
+		{	mulc_ssse3_half(&lo, &hi, k) ;
+			lo = _mm_xor_si128(lo, _mm_load_si128((const __m128i *)(in[q].lo + h))) ;
+			hi = _mm_xor_si128(hi, _mm_load_si128((const __m128i *)(in[q].hi + h))) ;
+		}
+		_mm_store_si128((__m128i *)(acc->lo + h), lo) ;
+		_mm_store_si128((__m128i *)(acc->hi + h), hi) ;
+	}
+}
+
+__attribute__((target("ssse3")))
+static uint32_t chien_ssse3(gf_planes *term, const gf_const *k, int deg)
+{	__m128i lo, hi, slo, shi ;
+	uint32_t found ;
+	int h, j ;
+
+	found = 0 ;
+	for (h = 0; h < gf_lanes; h += 16)
+	{	slo = _mm_setzero_si128() ;
+		shi = _mm_setzero_si128() ;
+		for (j = 1; j <= deg; j++)
+		{	lo = _mm_load_si128((const __m128i *)(term[j].lo + h)) ;
+			hi = _mm_load_si128((const __m128i *)(term[j].hi + h)) ;
+			slo = _mm_xor_si128(slo, lo) ;
+			shi = _mm_xor_si128(shi, hi) ;
+			mulc_ssse3_half(&lo, &hi, &k[j]) ;
+			_mm_store_si128((__m128i *)(term[j].lo + h), lo) ;
+			_mm_store_si128((__m128i *)(term[j].hi + h), hi) ;
+		}
+		slo = _mm_and_si128(_mm_cmpeq_epi8(slo, _mm_set1_epi8(1)), _mm_cmpeq_epi8(shi, _mm_setzero_si128())) ;
+		found |= (uint32_t)_mm_movemask_epi8(slo) << h ;
+	}
+	return found ;
+}
+
+// AVX2: 32 lanes per register, PSHUFB on both 128-bit halves
+
+__attribute__((target("avx2")))
+static inline void mulc_avx2_reg(__m256i *lo, __m256i *hi, const gf_const *k)
+{	__m256i mask, n0, n1, n2, n3, rlo, rhi ;
+
+	mask = _mm256_set1_epi8(0x0f) ;
+	n0 = _mm256_and_si256(*lo, mask) ;
+	n1 = _mm256_and_si256(_mm256_srli_epi16(*lo, 4), mask) ;
+	n2 = _mm256_and_si256(*hi, mask) ;
+	n3 = _mm256_and_si256(_mm256_srli_epi16(*hi, 4), mask) ;
+
+#define NIB(i)	_mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *)k->nib[i]))
+	rlo = _mm256_xor_si256(_mm256_shuffle_epi8(NIB(0), n0), _mm256_shuffle_epi8(NIB(2), n1)) ;
+	rlo = _mm256_xor_si256(rlo, _mm256_shuffle_epi8(NIB(4), n2)) ;
+	rlo = _mm256_xor_si256(rlo, _mm256_shuffle_epi8(NIB(6), n3)) ;
+	rhi = _mm256_xor_si256(_mm256_shuffle_epi8(NIB(1), n0), _mm256_shuffle_epi8(NIB(3), n1)) ;
+	rhi = _mm256_xor_si256(rhi, _mm256_shuffle_epi8(NIB(5), n2)) ;
+	rhi = _mm256_xor_si256(rhi, _mm256_shuffle_epi8(NIB(7), n3)) ;
+#undef NIB
+	*lo = rlo ;
+	*hi = rhi ;
+}
+
+// GFNI: the four 8x8 blocks of the 16x16 multiply matrix
+
+__attribute__((target("gfni,avx2")))
+static inline void mulc_gfni_reg(__m256i *lo, __m256i *hi, const gf_const *k)
+{	__m256i rlo, rhi ;
+
+	rlo = _mm256_xor_si256(_mm256_gf2p8affine_epi64_epi8(*lo, _mm256_set1_epi64x(k->aff[0]), 0),
+			       _mm256_gf2p8affine_epi64_epi8(*hi, _mm256_set1_epi64x(k->aff[1]), 0)) ;
+	rhi = _mm256_xor_si256(_mm256_gf2p8affine_epi64_epi8(*lo, _mm256_set1_epi64x(k->aff[2]), 0),
+			       _mm256_gf2p8affine_epi64_epi8(*hi, _mm256_set1_epi64x(k->aff[3]), 0)) ;
+	*lo = rlo ;
+	*hi = rhi ;
+}
+
+#define GF_KERNEL_256(isa, target_isa, MULC)						\
+__attribute__((target(target_isa)))							\
+static void mulc_##isa(gf_planes *x, const gf_const *k)					\
+{	__m256i lo, hi ;								\
+											\
+	lo = _mm256_load_si256((const __m256i *)x->lo) ;				\
+	hi = _mm256_load_si256((const __m256i *)x->hi) ;				\
+	MULC(&lo, &hi, k) ;								\
+	_mm256_store_si256((__m256i *)x->lo, lo) ;					\
+	_mm256_store_si256((__m256i *)x->hi, hi) ;					\
+}											\
+											\
+__attribute__((target(target_isa)))							\
+static void horner_##isa(gf_planes *acc, const gf_const *k, const gf_planes *in, int n)	\
+{	__m256i lo, hi ;								\
+	int q ;										\
+											\
+	lo = _mm256_load_si256((const __m256i *)acc->lo) ;				\
+	hi = _mm256_load_si256((const __m256i *)acc->hi) ;				\
+	for (q = n - 1; q >= 0; q--)							\
+	{	MULC(&lo, &hi, k) ;							\
+		lo = _mm256_xor_si256(lo, _mm256_load_si256((const __m256i *)in[q].lo)) ;	\
+		hi = _mm256_xor_si256(hi, _mm256_load_si256((const __m256i *)in[q].hi)) ;	\
+	}										\
+	_mm256_store_si256((__m256i *)acc->lo, lo) ;					\
+	_mm256_store_si256((__m256i *)acc->hi, hi) ;					\
+}											\
+											\
+__attribute__((target(target_isa)))							\
+static uint32_t chien_##isa(gf_planes *term, const gf_const *k, int deg)		\
+{	__m256i lo, hi, slo, shi ;							\
+	int j ;										\
+											\
+	slo = _mm256_setzero_si256() ;							\
+	shi = _mm256_setzero_si256() ;							\
+	for (j = 1; j <= deg; j++)							\
+	{	lo = _mm256_load_si256((const __m256i *)term[j].lo) ;			\
+		hi = _mm256_load_si256((const __m256i *)term[j].hi) ;			\
+		slo = _mm256_xor_si256(slo, lo) ;					\
+		shi = _mm256_xor_si256(shi, hi) ;					\
+		MULC(&lo, &hi, &k[j]) ;							\
+		_mm256_store_si256((__m256i *)term[j].lo, lo) ;				\
+		_mm256_store_si256((__m256i *)term[j].hi, hi) ;				\
+	}										\
+	slo = _mm256_and_si256(_mm256_cmpeq_epi8(slo, _mm256_set1_epi8(1)),		\
+			       _mm256_cmpeq_epi8(shi, _mm256_setzero_si256())) ;	\
+	return (uint32_t)_mm256_movemask_epi8(slo) ;					\
+}
+
+GF_KERNEL_256(avx2, "avx2", mulc_avx2_reg)
+GF_KERNEL_256(gfni, "gfni,avx2", mulc_gfni_reg)
+
+static const gf_kernel gf_kernels[] = {
+	{ "gfni", mulc_gfni, horner_gfni, chien_gfni },
+	{ "avx2", mulc_avx2, horner_avx2, chien_avx2 },
+	{ "ssse3", mulc_ssse3, horner_ssse3, chien_ssse3 },
+} ;
+
+static int gf_kernel_supported(const gf_kernel *kern)
+{	__builtin_cpu_init() ;
+	if (kern == &gf_kernels[0])
+		return __builtin_cpu_supports("gfni") && __builtin_cpu_supports("avx2") ;
+	if (kern == &gf_kernels[1])
+		return __builtin_cpu_supports("avx2") ;
+	return __builtin_cpu_supports("ssse3") ;
+}
+
+#endif
+
+int gf_select_kernel(const char *name, int mm, const gf_kernel **kern)
+/* Pick the vector kernel for GF(2**mm) by name, or the best one the CPU
+ * supports when name is NULL.  "scalar" selects the table lookup code, which
+ * is a NULL kernel.  Returns -1 if the named kernel is unknown or not
+ * supported.
+ */
+{	int i ;
+
+	*kern = NULL ;
+	if (name != NULL && strcmp(name, "scalar") == 0)
+		return 0 ;
+#ifdef GF_X86
+	for (i = 0; i < (int)(sizeof(gf_kernels) / sizeof(gf_kernels[0])); i++)
+	{	if (name != NULL && strcmp(name, gf_kernels[i].name) != 0)
+			continue ;
+		if (mm <= 16 && gf_kernel_supported(&gf_kernels[i]))
+		{	*kern = &gf_kernels[i] ;
+			return 0 ;
+		}
+		if (name != NULL)
+			return -1 ;
+	}
+#endif
+	return name == NULL ? 0 : -1 ;
+}
@@ -1,149 +1,282 @@
-/*******************************************************************************
-*
-*    File Name:  error_generator.c
-*     Revision:  2.0
-*         Date:  March, 2007
-*        Email:  nandsupport@micron.com
-*      Company:  Micron Technology, Inc.
-*
-*  Description:  corrupt data streams randomly
-**
-*   Disclaimer   This software code and all associated documentation, comments or other 
-*  of Warranty:  information (collectively "Software") is provided "AS IS" without 
-*                warranty of any kind. MICRON TECHNOLOGY, INC. ("MTI") EXPRESSLY 
-*                DISCLAIMS ALL WARRANTIES EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED 
-*                TO, NONINFRINGEMENT OF THIRD PARTY RIGHTS, AND ANY IMPLIED WARRANTIES 
-*                OF MERCHANTABILITY OR FITNESS FOR ANY PARTICULAR PURPOSE. MTI DOES NOT 
-*                WARRANT THAT THE SOFTWARE WILL MEET YOUR REQUIREMENTS, OR THAT THE 
-*                OPERATION OF THE SOFTWARE WILL BE UNINTERRUPTED OR ERROR-FREE. 
-*                FURTHERMORE, MTI DOES NOT MAKE ANY REPRESENTATIONS REGARDING THE USE OR 
-*                THE RESULTS OF THE USE OF THE SOFTWARE IN TERMS OF ITS CORRECTNESS, 
-*                ACCURACY, RELIABILITY, OR OTHERWISE. THE ENTIRE RISK ARISING OUT OF USE 
-*                OR PERFORMANCE OF THE SOFTWARE REMAINS WITH YOU. IN NO EVENT SHALL MTI, 
-*                ITS AFFILIATED COMPANIES OR THEIR SUPPLIERS BE LIABLE FOR ANY DIRECT, 
-*                INDIRECT, CONSEQUENTIAL, INCIDENTAL, OR SPECIAL DAMAGES (INCLUDING, 
-*                WITHOUT LIMITATION, DAMAGES FOR LOSS OF PROFITS, BUSINESS INTERRUPTION, 
-*                OR LOSS OF INFORMATION) ARISING OUT OF YOUR USE OF OR INABILITY TO USE 
-*                THE SOFTWARE, EVEN IF MTI HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH 
-*                DAMAGES. Because some jurisdictions prohibit the exclusion or 
-*                limitation of liability for consequential or incidental damages, the 
-*                above limitation may not apply to you.
-*
-*                Copyright 2007 Micron Technology, Inc. All rights reserved.
-*
-* 
-* Rev  Author		Date		Changes
-* ---  ---------------	----------	-------------------------------
-* 1.0  ZS		08/07/2006	Initial release
-* 2.0  PF		03/05/2007	Added options "-s" and "-r"
-* 
-* 
-******************************************************************************/
-
-#include "bch_global.c"
-int codeword[16 * kk_max] ;	// Incoming data
-
-int main(int argc,  char** argv)
-{	int i, j ;
-	int Error_Number ;	// Number of errors applied
-	int Help;
-	int rec_mode=0;
-	int in_count, in_v;
-	int in_count_rec;
-	int seed;
-	char in_char;
-	int wd_cnt[8];
-	
-	fprintf(stderr, "# Random error generator.  Use -h for details.\n\n");
-	
-	Help = 0;
-	Error_Number = 1;
-	seed = 1;
-	for (i=1; i < argc;i++) 
-	{	if (argv[i][0] == '-') 
-		{	switch (argv[i][1]) 
-			{	case 'e': Error_Number = atoi(argv[++i]);
-					  break;
-				case 's': seed = atoi(argv[++i]);
-					  break;
-				case 'r': rec_mode=1;
-			  		break;
-				default: Help = 1;
-			}
-		}
-		else 
-			Help = 1;
-	}
-	
-	if (Help == 1)
-	{	fprintf(stdout,"# Usage %s:  Error generator\n",argv[0]);
-		fprintf(stdout,"    -h:  This help message\n");
-		fprintf(stdout,"    -r: record based mode, all errors are in a record (terminated by newline).\n");
-		fprintf(stdout,"    -e <error>:  Number of errors in codeword.  Default = %d\n", Error_Number);
-		fprintf(stdout,"    -s <seed>:  Set the seed for the random number generator.  Default = %d\n", seed);
-		fprintf(stdout,"    <stdout>:  resulting corrupted data string in hex format.\n");
-		fprintf(stdout,"    <stderr>:  information about the process as well as error messages\n");
-	}
-	else
-	{	in_count = 0;
-		in_count_rec = 1;
-	  	wd_cnt[0]=wd_cnt[1]=wd_cnt[2]=wd_cnt[3]=wd_cnt[4]=wd_cnt[5]=wd_cnt[6]=wd_cnt[7]=0;
-		in_char = getchar();
-		srand(seed);
-		fprintf(stdout, "{ Seed = %d }\n",seed);
-		
-		while (in_char != EOF) 
-		{	if (in_char=='{') 
-			{	while ((in_char != EOF) && ((char)in_char != '}'))
-					in_char = getchar();
-			}
-			in_v = hextoint(in_char);		
-			if (in_v != -1)
-			{	for (i = 3; i >= 0; i--) 
-				{	if ((int)pow(2,i) & in_v)
-						codeword[in_count] = 1 ;
-					else
-						codeword[in_count] = 0 ;
-					in_count++;
-				}
-			} else 
-			{	fprintf(stderr,"in_count: %d\n",in_count);
-			  	if (rec_mode && in_count)
-			    	{ 	fprintf(stdout, "{%6d) %d errors applied.  Errors locations are:}\n{", in_count_rec, Error_Number);
-			      		fprintf(stderr, "{%6d) %d errors applied.  Errors locations are:}\n{", in_count_rec, Error_Number);
-			      		for (i = 0; i < Error_Number; i++)
-					{	j = rand() % in_count ;
-				  		codeword[j] = codeword[j] ^ 1;
-				  		fprintf(stdout, " %d", j);
-				  		fprintf(stderr, " %d", j);
-				  		wd_cnt[j*8/in_count]++;
-					}
-			      		fprintf(stdout, " }\n\n");
-			      		fprintf(stderr, " }\n");
-			      		print_hex_low(in_count, codeword, stdout);
-			      		fprintf(stdout,"\n");
-			      		in_count=0;
-			      		in_count_rec++;
-			    	}
-			}
-			in_char = getchar();
-		}
-		if (rec_mode) return(0);
-		fprintf(stderr, "# Total number of bits is: %d.\n\n", in_count) ;
-		fprintf(stdout, "{%d errors applied.  Error bits locations are:}\n{", Error_Number);
-		for (i = 0; i < Error_Number; i++)
-		{	j = rand() % in_count ;
-			codeword[j] = codeword[j] ^ 1;
-			fprintf(stdout, " %d", j);
-			wd_cnt[j*8/in_count]++;
-		}
-		fprintf(stdout, " }\n\n");
-		fprintf(stderr, "word counts:");
-		for (i=0;i<8;i++)
-			fprintf(stderr," %d",wd_cnt[i]);
-		fprintf(stderr,"\n");
-		print_hex_low(in_count, codeword, stdout);
-	}
-	
-	return(0);
-}
+/*******************************************************************************
+*
+*    File Name:  error_generator.c
+*     Revision:  2.0
+*         Date:  March, 2007
+*        Email:  nandsupport@micron.com
+*      Company:  Micron Technology, Inc.
+*
+*  Description:  corrupt data streams randomly
+**
+*   Disclaimer   This software code and all associated documentation, comments or other 
+*  of Warranty:  information (collectively "Software") is provided "AS IS" without 
+*                warranty of any kind. MICRON TECHNOLOGY, INC. ("MTI") EXPRESSLY 
+*                DISCLAIMS ALL WARRANTIES EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED 
+*                TO, NONINFRINGEMENT OF THIRD PARTY RIGHTS, AND ANY IMPLIED WARRANTIES 
+*                OF MERCHANTABILITY OR FITNESS FOR ANY PARTICULAR PURPOSE. MTI DOES NOT 
+*                WARRANT THAT THE SOFTWARE WILL MEET YOUR REQUIREMENTS, OR THAT THE 
+*                OPERATION OF THE SOFTWARE WILL BE UNINTERRUPTED OR ERROR-FREE. 
+*                FURTHERMORE, MTI DOES NOT MAKE ANY REPRESENTATIONS REGARDING THE USE OR 
+*                THE RESULTS OF THE USE OF THE SOFTWARE IN TERMS OF ITS CORRECTNESS, 
+*                ACCURACY, RELIABILITY, OR OTHERWISE. THE ENTIRE RISK ARISING OUT OF USE 
+*                OR PERFORMANCE OF THE SOFTWARE REMAINS WITH YOU. IN NO EVENT SHALL MTI, 
+*                ITS AFFILIATED COMPANIES OR THEIR SUPPLIERS BE LIABLE FOR ANY DIRECT, 
+*                INDIRECT, CONSEQUENTIAL, INCIDENTAL, OR SPECIAL DAMAGES (INCLUDING, 
+*                WITHOUT LIMITATION, DAMAGES FOR LOSS OF PROFITS, BUSINESS INTERRUPTION, 
+*                OR LOSS OF INFORMATION) ARISING OUT OF YOUR USE OF OR INABILITY TO USE 
+*                THE SOFTWARE, EVEN IF MTI HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH 
+*                DAMAGES. Because some jurisdictions prohibit the exclusion or 
+*                limitation of liability for consequential or incidental damages, the 
+*                above limitation may not apply to you.
+*
+*                Copyright 2007 Micron Technology, Inc. All rights reserved.
+*
+* 
+* Rev  Author		Date		Changes
+* ---  ---------------	----------	-------------------------------
+* 1.0  ZS		08/07/2006	Initial release
+* 2.0  PF		03/05/2007	Added options "-s" and "-r"
+* 
+* 
+******************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bch.h"
+unsigned char *codeword ;		// Incoming data, MSB first
+unsigned char *error_mask ;		// Bits to flip, same layout
+int codeword_size ;			// Bytes allocated to each
+int *location ;				// Error positions, ascending
+int location_size ;			// Entries allocated
+
+int read_codeword(hex_input *in, int record)
+/* Read the whole input, or one record, into codeword, growing it as needed.
+ * Returns the number of hex digits read, or -1 if out of memory.
+ */
+{	unsigned char *grown ;
+	int count, n, size ;
+
+	count = 0 ;
+	for (;;)
+	{	if (2 * codeword_size - count < 16)
+		{	size = codeword_size ? 2 * codeword_size : 4096 ;
+			grown = realloc(codeword, size) ;
+			if (grown == NULL)
+				return -1 ;
+			codeword = grown ;
+			grown = realloc(error_mask, size) ;
+			if (grown == NULL)
+				return -1 ;
+			error_mask = grown ;
+			codeword_size = size ;
+		}
+		n = hex_read(in, codeword + count / 2, 2 * codeword_size - count, record) ;
+		count += n ;
+		if (count < 2 * codeword_size || in->eof)
+			return count ;
+	}
+}
+
+int apply_errors(bch_rng *rng, int bits, int weight, double log_q)
+/* Flip exactly weight distinct bits of the first bits of codeword, or, if
+ * weight < 0, each bit with probability p, log_q being log(1 - p).  The
+ * errors are marked in error_mask first (Floyd's sampling for a weight,
+ * geometric gaps between the errors of the channel), so the cost is that
+ * of the errors plus one pass over the bytes.  Leaves the positions in
+ * location.  Returns how many, or -1 if out of memory.
+ */
+{	uint64_t w ;
+	int *grown ;
+	int i, j, h, n, bytes ;
+	long b ;
+
+	bytes = (bits + 7) / 8 ;
+	memset(error_mask, 0, bytes) ;
+	n = 0 ;
+	if (weight >= 0)
+		for (j = bits - weight; j < bits; j++)
+		{	i = bch_rng_below(rng, j + 1) ;
+			if (error_mask[i >> 3] & (0x80 >> (i & 7)))
+				i = j ;
+			error_mask[i >> 3] |= 0x80 >> (i & 7) ;
+		}
+	else
+		for (b = bch_rng_gap(rng, log_q); b < bits; b += 1 + bch_rng_gap(rng, log_q))
+			error_mask[b >> 3] |= 0x80 >> (b & 7) ;
+
+	for (i = 0; i < bytes; i += 8)
+	{	w = 0 ;
+		memcpy(&w, error_mask + i, bytes - i < 8 ? bytes - i : 8) ;
+		if (w == 0)
+			continue ;
+		for (j = i; j < i + 8 && j < bytes; j++)
+		{	codeword[j] ^= error_mask[j] ;
+			for (b = error_mask[j]; b; b ^= 1 << h)
+			{	h = 31 - __builtin_clz((unsigned)b) ;
+				if (n == location_size)
+				{	grown = realloc(location, (location_size ? 2 * location_size : 1024) * sizeof(int)) ;
+					if (grown == NULL)
+						goto fail ;
+					location = grown ;
+					location_size = location_size ? 2 * location_size : 1024 ;
+				}
+				location[n++] = 8 * j + 7 - h ;
+			}
+		}
+	}
+	return n ;
+
+fail:
+	free(codeword) ;
+	free(error_mask) ;
+	free(location) ;
+	codeword = error_mask = NULL ;
+	location = NULL ;
+	codeword_size = location_size = 0 ;
+	return -1 ;
+}
+
+int main(int argc,  char** argv)
+{	int i, j ;
+	int Error_Number ;	// Number of errors applied, or -1 for the channel
+	double Error_Rate ;	// Bit error rate of the channel
+	int Help;
+	int rec_mode=0;
+	int in_count;
+	int in_count_rec;
+	int seed;
+	int applied;
+	bch_rng rng;
+	hex_input *in;
+	int wd_cnt[8];
+	
+	fprintf(stderr, "# Random error generator.  Use -h for details.\n\n");
+	
+	Help = 0;
+	Error_Number = 1;
+	Error_Rate = 0;
+	seed = 1;
+	for (i=1; i < argc;i++) 
+	{	if (argv[i][0] == '-') 
+		{	switch (argv[i][1]) 
+			{	case 'e': Error_Number = i + 1 < argc ? atoi(argv[++i]) : -1;
+					  if (Error_Number < 0)
+						Help = 1;
+					  break;
+				case 'b': Error_Rate = i + 1 < argc ? atof(argv[++i]) : -1;
+					  if (!(Error_Rate > 0 && Error_Rate < 1))
+						Help = 1;
+					  break;
+				case 's': seed = i + 1 < argc ? atoi(argv[++i]) : 1;
+					  break;
+				case 'r': rec_mode=1;
+			  		break;
+				default: Help = 1;
+			}
+		}
+		else 
+			Help = 1;
+	}
+	if (Error_Rate > 0)
+		Error_Number = -1;
+	
+	if (Help == 1)
+	{	fprintf(stdout,"# Usage %s:  Error generator\n",argv[0]);
+		fprintf(stdout,"    -h:  This help message\n");
+		fprintf(stdout,"    -r: record based mode, all errors are in a record (terminated by newline).\n");
+		fprintf(stdout,"         Records are read and corrupted one at a time, so the input may\n");
+		fprintf(stdout,"         be of any length.\n");
+		fprintf(stdout,"    -e <error>:  Number of errors in codeword, all on distinct bits.\n");
+		fprintf(stdout,"         Default = 1\n");
+		fprintf(stdout,"    -b <rate>:  Binary symmetric channel instead:  each bit is flipped\n");
+		fprintf(stdout,"         with this probability.  Default disabled.\n");
+		fprintf(stdout,"    -s <seed>:  Set the seed for the random number generator.  Default = 1\n");
+		fprintf(stdout,"         Record i is corrupted from stream i of the seed.\n");
+		fprintf(stdout,"    <stdout>:  resulting corrupted data string in hex format.\n");
+		fprintf(stdout,"    <stderr>:  information about the process as well as error messages\n");
+	}
+	else
+	{	in_count_rec = 1;
+		applied = 0;
+	  	wd_cnt[0]=wd_cnt[1]=wd_cnt[2]=wd_cnt[3]=wd_cnt[4]=wd_cnt[5]=wd_cnt[6]=wd_cnt[7]=0;
+		in = hex_open(0);
+		if (in == NULL)
+		{	fprintf(stderr, "### Out of memory.\n\n");
+			return(1);
+		}
+		fprintf(stdout, "{ Seed = %d }\n",seed);
+		
+		if (rec_mode)
+		{	// A record is ended by the first character that is not hex; one
+			// still open at the end of the input is dropped
+			while ((in_count = 4 * read_codeword(in, 1)) > 0 && !in->eof)
+			{	if (Error_Number > in_count)
+				{	fprintf(stderr, "### %d errors do not fit in the %d bits of record %d.\n\n",
+						Error_Number, in_count, in_count_rec);
+					return(1);
+				}
+				bch_rng_seed(&rng, seed, in_count_rec);
+				applied = apply_errors(&rng, in_count, Error_Number, log1p(-Error_Rate));
+				if (applied < 0)
+					break;
+				fprintf(stdout, "{%6d) %d errors applied.  Errors locations are:}\n{", in_count_rec, applied);
+				fprintf(stderr, "{%6d) %d errors applied.  Errors locations are:}\n{", in_count_rec, applied);
+				for (i = 0; i < applied; i++)
+				{	fprintf(stdout, " %d", location[i]);
+					fprintf(stderr, " %d", location[i]);
+				}
+				fprintf(stdout, " }\n\n");
+				fprintf(stderr, " }\n");
+				print_hex_bytes(0, in_count, codeword, stdout);
+				fprintf(stdout,"\n");
+				in_count_rec++;
+			}
+			hex_close(in);
+			free(codeword);
+			free(error_mask);
+			free(location);
+			if (in_count < 0 || applied < 0)
+			{	fprintf(stderr, "### Out of memory.\n\n");
+				return(1);
+			}
+			return(0);
+		}
+		
+		in_count = 4 * read_codeword(in, 0);
+		hex_close(in);
+		if (in_count < 0)
+		{	fprintf(stderr, "### Out of memory.\n\n");
+			return(1);
+		}
+		fprintf(stderr, "# Total number of bits is: %d.\n\n", in_count) ;
+		if (Error_Number > in_count)
+		{	fprintf(stderr, "### %d errors do not fit in %d bits.\n\n", Error_Number, in_count);
+			return(1);
+		}
+		bch_rng_seed(&rng, seed, 0);
+		applied = in_count ? apply_errors(&rng, in_count, Error_Number, log1p(-Error_Rate)) : 0;
+		if (applied < 0)
+		{	fprintf(stderr, "### Out of memory.\n\n");
+			return(1);
+		}
+		fprintf(stdout, "{%d errors applied.  Error bits locations are:}\n{", applied);
+		for (i = 0; i < applied; i++)
+		{	j = location[i];
+			fprintf(stdout, " %d", j);
+			wd_cnt[(long long)j*8/in_count]++;
+		}
+		fprintf(stdout, " }\n\n");
+		fprintf(stderr, "word counts:");
+		for (i=0;i<8;i++)
+			fprintf(stderr," %d",wd_cnt[i]);
+		fprintf(stderr,"\n");
+		print_hex_bytes(0, in_count, codeword, stdout);
+		free(codeword);
+		free(error_mask);
+		free(location);
+	}
+	
+	return(0);
+}